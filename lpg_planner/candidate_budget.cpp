@@ -0,0 +1,69 @@
+#include "candidate_budget.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+
+void CandidateBudget::update(
+  double elapsed,
+  unsigned long subsets
+)
+{
+  // Ignore meaningless measurements.
+  if(subsets == 0 || elapsed <= 0.0) {
+    return;
+  }
+
+  // Blend the new measurement with the current estimate.
+  double cost = elapsed / subsets;
+  subset_cost_ = isCalibrated() ? (1-SMOOTHING) * subset_cost_ + SMOOTHING * cost : cost;
+}
+
+
+unsigned long CandidateBudget::subsetCount(
+  int candidates
+)
+{
+  if(candidates < 2 || candidates > MAX_CANDIDATES) {
+    return 0;
+  }
+  return 1ul << (candidates - 2);
+}
+
+
+int CandidateBudget::maxCandidates(
+  double target_time
+) const
+{
+  if(!isCalibrated()) {
+    return MAX_CANDIDATES;
+  }
+
+  // Departure and arrival are always part of the route, so that with n
+  // candidates we solve 2^(n-2) subsets.
+  double affordable_subsets = target_time / subset_cost_;
+  if(affordable_subsets < 1.0) {
+    return 2;
+  }
+  int candidates = 2 + static_cast<int>(std::floor(std::log2(affordable_subsets)));
+  return std::clamp(candidates, 2, MAX_CANDIDATES);
+}
+
+
+double CandidateBudget::segmentLength(
+  double target_time,
+  double path_length,
+  int window_overlap,
+  int stations_per_window,
+  double min_length
+) const
+{
+  // Each window provides (at most) stations_per_window candidates, and two
+  // more are added at the departure and arrival.
+  int windows = std::max(1, (maxCandidates(target_time) - 2) / stations_per_window);
+
+  // With segments of length l, the path is cut into ceil(W*L/l) cells and
+  // there are (cells-W+1) windows.
+  int cells = windows + window_overlap - 1;
+  return std::max(min_length, window_overlap * path_length / cells);
+}
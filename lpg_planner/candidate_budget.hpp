@@ -0,0 +1,76 @@
+#ifndef CANDIDATE_BUDGET_HPP
+#define CANDIDATE_BUDGET_HPP
+
+
+/// Controller that limits the number of candidate stations.
+/** The planner enumerates all subsets of the candidate stations, so that the
+  * time needed to find a solution grows exponentially with their number. This
+  * class keeps an estimate of the time needed to solve one subset, and uses
+  * it to decide how many candidates can be afforded given a target solve
+  * time. The estimate should be initialized with a small benchmark (see
+  * update()) and refined after each plan.
+  */
+class CandidateBudget {
+public:
+  /// Create a controller with no estimate of the solve time.
+  CandidateBudget() = default;
+
+  /// Tell if the cost per subset has been measured at least once.
+  inline bool isCalibrated() const { return subset_cost_ > 0.0; }
+
+  /// Estimated time, in seconds, needed to solve one subset of stations.
+  inline double subsetCost() const { return subset_cost_; }
+
+  /// Refine the estimate of the solve time using a new measurement.
+  /** The new measurement is blended with the current estimate using an
+    * exponential moving average, unless this is the first measurement.
+    * @param elapsed Time, in seconds, spent solving all subsets.
+    * @param subsets Number of subsets solved in the given time.
+    */
+  void update(double elapsed, unsigned long subsets);
+
+  /// Maximum number of candidates that can be solved within a given time.
+  /** @param target_time Desired solve time, in seconds.
+    * @return The number of candidates, including departure and arrival, that
+    *   can be afforded. It is at least 2, and at most MAX_CANDIDATES. If the
+    *   controller is not calibrated, MAX_CANDIDATES is returned.
+    */
+  int maxCandidates(double target_time) const;
+
+  /// Choose a segment length that yields an affordable number of candidates.
+  /** @param target_time Desired solve time, in seconds.
+    * @param path_length Length of the path, in km.
+    * @param window_overlap Number of cells spanned by each window.
+    * @param stations_per_window Number of stations selected in each window.
+    * @param min_length Smallest segment length that can be returned.
+    * @return The length of the segments, in km.
+    */
+  double segmentLength(
+    double target_time,
+    double path_length,
+    int window_overlap,
+    int stations_per_window,
+    double min_length
+  ) const;
+
+  /// Number of subsets that are solved for a given number of candidates.
+  /** Departure and arrival are part of all subsets, so that n candidates
+    * yield 2^(n-2) subsets.
+    * @param candidates Number of candidates, including departure and arrival.
+    * @return The number of subsets, or 0 if there are less than 2 candidates
+    *   or more than MAX_CANDIDATES (in which case they cannot be enumerated).
+    */
+  static unsigned long subsetCount(int candidates);
+
+  /// Largest number of candidates ever returned by maxCandidates().
+  /** Subsets are enumerated using the bits of an unsigned long, which sets a
+    * hard limit to the number of candidates.
+    */
+  static constexpr int MAX_CANDIDATES = 24;
+
+private:
+  double subset_cost_ = 0.0; ///< Estimated time needed to solve a subset.
+  static constexpr double SMOOTHING = 0.3; ///< Weight of new measurements.
+};
+
+#endif // CANDIDATE_BUDGET_HPP
@@ -1,109 +1,199 @@
 #include "database_manager.hpp"
 
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QHash>
+#include <QSqlDatabase>
+#include <QSqlError>
 #include <QSqlRecord>
 #include <QStandardPaths>
+#include <QThread>
+#include <algorithm>
 
 
-// Helper function: resize the objects, if they are not null. Having a specific
-// function ensures that the operation (which would be valid also on
-// QStringList* objects) is done instead for the correct type.
-template<class T>
-inline void resize(
-  unsigned int size,
-  std::initializer_list<QList<T>*> fields
+// Helper function that applies the settings that SQLite does not store in the
+// database, and must be set for each connection. In WAL mode, NORMAL
+// synchronization is safe (a power loss can only undo the last transactions)
+// and it syncs to disk only at checkpoints, rather than at each commit.
+void configureConnection(
+  QSqlDatabase& db
 )
 {
-  // Force the compiler to accept only QList<int> and QList<double> as inputs.
-  static_assert(
-    std::is_same_v<T,int> || std::is_same_v<T,double>,
-    "resize(uint, {QList<T>*}): T must be int or double"
-  );
-
-  // For each input, resize it if it is not nullptr.
-  for(auto* field : fields) {
-    if(field != nullptr) {
-      field->resize(size);
+  QSqlQuery query(db);
+  for(const QString& pragma : {
+    QString("PRAGMA synchronous = NORMAL;"),
+    QString("PRAGMA wal_autocheckpoint = %1;").arg(DatabaseManager::WAL_AUTOCHECKPOINT_PAGES),
+    QString("PRAGMA journal_size_limit = %1;").arg(DatabaseManager::WAL_SIZE_LIMIT_BYTES)
+  }) {
+    if(!query.exec(pragma)) {
+      qDebug() << "Failed to run" << pragma << ":" << query.lastError().text();
     }
   }
 }
 
 
-// Helper function: clear and reserve memory for the objects (if not null).
-template<class T>
-inline void reserve(
-  unsigned int size,
-  std::initializer_list<QList<T>*> fields
-)
-{
-  // Force the compiler to accept only int, double and QString as inputs.
-  static_assert(
-    std::is_same_v<T,int> || std::is_same_v<T,double> || std::is_same_v<T,QString>,
-    "reserve(uint, {QList<T>*}): T must be int, double or QString"
-  );
+// Helper class: copy the columns of query results into a StationData. The
+// requested columns must be selected in the order of the Column flags,
+// starting from the given index, so that they can be read by index.
+class StationDecoder {
+public:
+  StationDecoder(
+    DatabaseManager::StationData& stations,
+    DatabaseManager::Columns columns,
+    int first_index
+  )
+  {
+    int index = first_index;
+    auto add = [&](auto& fields, DatabaseManager::Column column, auto* list) {
+      if(columns.testFlag(column)) {
+        fields.append({list, index++});
+      }
+    };
+    add(int_fields_, DatabaseManager::ID, &stations.ids);
+    add(double_fields_, DatabaseManager::PRICE, &stations.prices);
+    add(double_fields_, DatabaseManager::LATITUDE, &stations.latitudes);
+    add(double_fields_, DatabaseManager::LONGITUDE, &stations.longitudes);
+    add(string_fields_, DatabaseManager::DATE, &stations.dates);
+    add(string_fields_, DatabaseManager::ADDRESS, &stations.addresses);
+  }
+
+  // Resize all the requested lists.
+  void resize(qsizetype size) {
+    for(auto [list, index] : int_fields_)
+      list->resize(size);
+    for(auto [list, index] : double_fields_)
+      list->resize(size);
+    for(auto [list, index] : string_fields_)
+      list->resize(size);
+  }
+
+  // Append the current record of the query to the lists.
+  void append(const QSqlQuery& query) {
+    for(auto [list, index] : int_fields_)
+      list->append(query.value(index).toInt());
+    for(auto [list, index] : double_fields_)
+      list->append(query.value(index).toDouble());
+    for(auto [list, index] : string_fields_)
+      list->append(query.value(index).toString());
+  }
 
-  // For each non-nullptr input, clear and reserve memory.
-  for(auto* field : fields) {
-    if(field != nullptr) {
-      field->resize(0);
-      field->reserve(size);
+  // Copy the current record of the query at the given positions of the lists.
+  void set(const QSqlQuery& query, const QList<int>& positions) {
+    for(auto [list, index] : int_fields_) {
+      int value = query.value(index).toInt();
+      for(int i : positions)
+        (*list)[i] = value;
+    }
+    for(auto [list, index] : double_fields_) {
+      double value = query.value(index).toDouble();
+      for(int i : positions)
+        (*list)[i] = value;
+    }
+    for(auto [list, index] : string_fields_) {
+      QString value = query.value(index).toString();
+      for(int i : positions)
+        (*list)[i] = value;
     }
   }
-}
+
+private:
+  QList<std::pair<QList<int>*, int>> int_fields_;
+  QList<std::pair<QList<double>*, int>> double_fields_;
+  QList<std::pair<QStringList*, int>> string_fields_;
+};
 
 
-// Helper function: for all "List-like" objects, call clear().
-template<typename... Lists>
-inline void clearLists(Lists*... lists)
+QStringList DatabaseManager::columnNames(
+  Columns columns
+)
 {
-  ( (lists ? lists->clear() : void()), ... );
+  QStringList names;
+  for(auto [column, name] : {
+    std::pair{ID, "id"},
+    std::pair{PRICE, "fuel_price"},
+    std::pair{LATITUDE, "latitude"},
+    std::pair{LONGITUDE, "longitude"},
+    std::pair{DATE, "price_date"},
+    std::pair{ADDRESS, "address"}
+  }) {
+    if(columns.testFlag(column)) {
+      names.append(name);
+    }
+  }
+  return names;
 }
 
 
 bool DatabaseManager::stationsFromIds(
   const QList<int>& ids,
-  QList<double>* prices,
-  QList<double>* latitudes,
-  QList<double>* longitudes,
-  QStringList* dates,
-  QStringList* addresses
+  Columns columns,
+  StationData& stations
 )
 {
-  // Resize QList<double> objects directly, and pre-allocate memory for
-  // QStringList objects. This should be more memory-efficient.
-  resize(ids.size(), {prices, latitudes, longitudes});
-  reserve(ids.size(), {dates, addresses});
-
-  // Compile a query to access all required data, one ID at a time.
-  QSqlQuery query;
-  if(!query.prepare("SELECT * FROM Stations WHERE id=?;")) {
-    qDebug() << "Failed to prepare select statement";
-    return false;
-  }
+  stations = StationData();
 
-  // Helper initializer lists.
-  auto double_fields = {std::pair{prices, "fuel_price"}, std::pair{latitudes, "latitude"}, std::pair{longitudes, "longitude"}};
-  auto string_fields = {std::pair{dates, "date"}, std::pair{addresses, "address"}};
+  // Use the snapshot if possible.
+  if(auto snapshot_stations = snapshot()) {
+    return snapshotStationsFromIds(*snapshot_stations, ids, columns, stations);
+  }
 
-  // Retrieve data, one record at a time.
-  for(unsigned int i=0; i<ids.size(); i++) {
-    // Run the query for the next ID, exit on failure.
-    query.addBindValue(ids[i]);
-    if(!query.exec() || !query.next()) {
-      clearLists(prices, latitudes, longitudes, dates, addresses);
+  // Records are not fetched in the order of the IDs, so all lists are resized
+  // right away and filled by position.
+  StationDecoder decoder(stations, columns, 1);
+  decoder.resize(ids.size());
+
+  // Positions of each ID in the input list (the same ID can appear more than
+  // once).
+  QHash<int, QList<int>> positions;
+  positions.reserve(ids.size());
+  for(int i=0; i<ids.size(); i++) {
+    positions[ids[i]].append(i);
+  }
+  const QList<int> unique_ids = positions.keys();
+
+  // Fetch the records in chunks, each with a single query. Only the requested
+  // columns are selected, after the ID.
+  QString select = (QStringList{"id"} + columnNames(columns)).join(", ");
+  QSqlQuery query(connection());
+  query.setForwardOnly(true);
+  int found = 0;
+  for(int first=0; first<unique_ids.size(); first+=IDS_PER_QUERY) {
+    const int count = std::min<int>(IDS_PER_QUERY, unique_ids.size() - first);
+    QStringList placeholders(count, QString("?"));
+    QString query_str = QString("SELECT %1 FROM Stations WHERE id IN (%2);").arg(
+      select,
+      placeholders.join(",")
+    );
+    if(!query.prepare(query_str)) {
+      qDebug() << "Failed to prepare select statement";
+      stations = StationData();
       return false;
     }
-
-    // Copy the reults into the corresponding lists.
-    for(auto [list, field] : double_fields) {
-      if(list != nullptr)
-        (*list)[i] = query.value(field).toDouble();
+    for(int i=first; i<first+count; i++) {
+      query.addBindValue(unique_ids[i]);
     }
-    for(auto [list, field] : string_fields) {
-      if(list != nullptr)
-        list->append(query.value(field).toString());
+    if(!query.exec()) {
+      qDebug() << "Failed to run query";
+      stations = StationData();
+      return false;
+    }
+
+    // Copy the results into the corresponding lists, at all positions of
+    // their ID.
+    while(query.next()) {
+      decoder.set(query, positions.value(query.value(0).toInt()));
+      found++;
     }
   }
 
+  // Fail if some IDs are not in the database.
+  if(found < unique_ids.size()) {
+    qDebug() << "Could not find" << unique_ids.size() - found << "stations in the database";
+    stations = StationData();
+    return false;
+  }
+
   // Success!
   return true;
 }
@@ -111,16 +201,28 @@ bool DatabaseManager::stationsFromIds(
 
 bool DatabaseManager::findStations(
   const Filter& filter,
-  QList<int>* ids,
-  QList<double>* prices,
-  QList<double>* latitudes,
-  QList<double>* longitudes,
-  QStringList* dates,
-  QStringList* addresses
+  Columns columns,
+  StationData& stations
+)
+{
+  // Use the snapshot if possible, otherwise query the database.
+  stations = StationData();
+  if(auto snapshot_stations = snapshot()) {
+    snapshotStations(*snapshot_stations, filter, columns, stations);
+    return true;
+  }
+  return queryStations(filter, columns, stations);
+}
+
+
+bool DatabaseManager::queryStations(
+  const Filter& filter,
+  Columns columns,
+  StationData& stations
 )
 {
   // Given the filter, obtain the corresponding query.
-  QSqlQuery query = filter.compile();
+  QSqlQuery query = filter.compile(columns);
   qDebug() << "Running query:" << query.lastQuery();
 
   // Execute the query, and exit on failure.
@@ -129,129 +231,196 @@ bool DatabaseManager::findStations(
     return false;
   }
 
-  if(!query.next()) {
-    qDebug() << "Query appears to be empty";
-    // If the first call to query.next() returns false, then there are no
-    // records matching the filter! Return "true" since this is not an error.
-    resize(0, {ids});
-    resize(0, {prices, latitudes, longitudes});
-    reserve(0, {dates, addresses});
-    return true;
+  // The number of records is not known in advance, so the lists grow as
+  // needed while the records are streamed.
+  StationDecoder decoder(stations, columns, 0);
+  while(query.next()) {
+    decoder.append(query);
   }
 
-  // Fetch the number of records - which is a field contained in each record!
-  unsigned int query_size = query.value("query_size").toInt();
-
-  // Reserve memory for the lists.
-  reserve(query_size, {ids});
-  reserve(query_size, {prices, latitudes, longitudes});
-  reserve(query_size, {dates, addresses});
+  return true;
+}
 
-  // Helper initializer lists.
-  auto int_fields = {std::pair{ids, "id"}};
-  auto double_fields = {std::pair{prices, "fuel_price"}, std::pair{latitudes, "latitude"}, std::pair{longitudes, "longitude"}};
-  auto string_fields = {std::pair{dates, "date"}, std::pair{addresses, "address"}};
 
-  do {
-    // Copy the reults into the corresponding lists.
-    for(auto [list, field] : int_fields) {
-      if(list != nullptr)
-        list->append(query.value(field).toInt());
-    }
-    for(auto [list, field] : double_fields) {
-      if(list != nullptr)
-        list->append(query.value(field).toDouble());
-    }
-    for(auto [list, field] : string_fields) {
-      if(list != nullptr)
-        list->append(query.value(field).toString());
+bool DatabaseManager::dataVersion(
+  qint64& version
+)
+{
+  // Version maintained by the triggers.
+  if(has_stations_version_) {
+    QSqlQuery query(connection());
+    if(!query.exec("SELECT value FROM Metadata WHERE key = 'stations_version';") || !query.next()) {
+      qDebug() << "Failed to read data version";
+      return false;
     }
-  } while(query.next());
+    version = query.value(0).toLongLong();
+    return true;
+  }
 
-  return true;
+  // Without the triggers, there is no version that is shared by all
+  // connections and kept across runs: the change counter in the header of the
+  // database file is not updated in WAL mode, and 'PRAGMA data_version' is
+  // local to each connection. Changes could go unnoticed, so no version is
+  // given.
+  return false;
+}
+
+
+QSqlDatabase DatabaseManager::connection()
+{
+  // Connections are named after the thread that uses them.
+  QThread* thread = QThread::currentThread();
+  const QString name = QString("lpg_planner_thread_%1").arg(quintptr(thread), 0, 16);
+  if(QSqlDatabase::contains(name)) {
+    return QSqlDatabase::database(name);
+  }
+
+  // Create a new connection, with the same settings as the default one, and
+  // remove it when the thread finishes (the finished() signal is emitted by
+  // the thread itself).
+  QSqlDatabase db = QSqlDatabase::cloneDatabase(QSqlDatabase::defaultConnection, name);
+  if(!db.open()) {
+    qDebug() << "Failed to open database connection" << name << ":" << db.lastError().text();
+  }
+  configureConnection(db);
+  QObject::connect(thread, &QThread::finished, [name]() {
+    QSqlDatabase::removeDatabase(name);
+  });
+  return db;
 }
 
 
 bool DatabaseManager::distancePairs(
   const QList<int>& ids,
-  QMap<QPair<int,int>,double>& distances
+  const QString& profile,
+  QList<QList<double>>& distances
 )
 {
+  // Missing pairs are marked with a negative distance.
+  distances = QList<QList<double>>(ids.size(), QList<double>(ids.size(), -1.0));
+
   // No need to do anything unless we have two or more locations!
   if(ids.size() <= 1) {
     return true;
   }
 
-  // Convert ints to strings.
-  QStringList ids_str;
-  ids_str.reserve(ids.size());
-  for(unsigned int i=0; i<ids.size(); i++) {
-    ids_str.append(QString::number(ids[i]));
+  // Load the IDs, alongside their position, into a temporary table. The table
+  // lives as long as the connection, and is emptied before each use.
+  QSqlQuery query(connection());
+  if(
+    !query.exec("CREATE TEMP TABLE IF NOT EXISTS QueryIds (idx INTEGER PRIMARY KEY, id INTEGER NOT NULL);") ||
+    !query.exec("CREATE INDEX IF NOT EXISTS temp.QueryIdsById ON QueryIds (id);") ||
+    !query.exec("DELETE FROM QueryIds;")
+  ) {
+    qDebug() << "Failed to prepare temporary table:" << query.lastError().text();
+    return false;
   }
 
-  // Create a query string that can select matching location pairs.
-  QString query_str = QString(
-    "SELECT * FROM Distances WHERE from_id IN (%1) AND to_id IN (%1)"
-  ).arg(
-    ids_str.join(",")
-  );
-  qDebug() << "Fetching records using:" << query_str;
+  QVariantList positions, values;
+  positions.reserve(ids.size());
+  values.reserve(ids.size());
+  for(int i=0; i<ids.size(); i++) {
+    positions.append(i);
+    values.append(ids[i]);
+  }
+  if(!query.prepare("INSERT INTO QueryIds (idx, id) VALUES (?, ?);")) {
+    qDebug() << "Failed to prepare query";
+    return false;
+  }
+  query.addBindValue(positions);
+  query.addBindValue(values);
+  if(!query.execBatch()) {
+    qDebug() << "Failed to fill temporary table:" << query.lastError().text();
+    return false;
+  }
 
-  // Retrieve all existing distance pairs from the database.
-  QSqlQuery query(query_str);
+  // Retrieve all existing distance pairs of the profile from the database, as
+  // positions in the matrix.
+  query.setForwardOnly(true);
+  if(!query.prepare(
+    "SELECT f.idx, t.idx, d.distance"
+    " "
+    "FROM QueryIds AS f CROSS JOIN QueryIds AS t"
+    " "
+    "JOIN Distances AS d ON d.profile = ? AND d.from_id = f.id AND d.to_id = t.id;"
+  )) {
+    qDebug() << "Failed to prepare query";
+    return false;
+  }
+  query.addBindValue(profile);
   if(!query.exec()) {
-    qDebug() << "Failed to execute query";
+    qDebug() << "Failed to execute query:" << query.lastError().text();
     return false;
   }
 
-  // Copy fetched records into the map.
+  // Copy fetched records into the matrix.
   while(query.next()) {
-    distances[{
-      query.value("from_id").toInt(),
-      query.value("to_id").toInt()
-    }] = query.value("distance").toDouble();
+    distances[query.value(0).toInt()][query.value(1).toInt()] = query.value(2).toDouble();
   }
   return true;
 }
 
 
 bool DatabaseManager::insertPairs(
-  const QMap<QPair<int,int>,double>& distances
+  const QMap<QPair<int,int>,double>& distances,
+  const QString& profile
 )
 {
   // Create a query that can insert distance pairs if they do not exist, or
   // update them if they exist.
   QString query_str = QString(
-    "INSERT INTO Distances (from_id, to_id, distance)"
+    "INSERT INTO Distances (profile, from_id, to_id, distance)"
     " "
-    "VALUES (?, ?, ?)"
+    "VALUES (?, ?, ?, ?)"
     " "
-    "ON CONFLICT(from_id, to_id)"
+    "ON CONFLICT(profile, from_id, to_id)"
     " "
     "DO UPDATE SET distance = excluded.distance;"
   );
   qDebug() << "Preparing query:" << query_str;
 
+  // All pairs are inserted in a single transaction: otherwise, SQLite would
+  // commit (and sync to disk) after each row.
+  QElapsedTimer timer;
+  timer.start();
+  QSqlDatabase db = connection();
+  if(!db.transaction()) {
+    qDebug() << "Failed to start transaction";
+    return false;
+  }
+
   // Prepare the query for execution.
-  QSqlQuery query;
+  QSqlQuery query(db);
   if(!query.prepare(query_str)) {
     qDebug() << "Failed to prepare query";
+    db.rollback();
     return false;
   }
 
-  // For each distance pair, run the query.
+  // Bind one list of values per column, and run the query for all pairs.
+  QVariantList profiles(distances.size(), profile), from_ids, to_ids, values;
+  from_ids.reserve(distances.size());
+  to_ids.reserve(distances.size());
+  values.reserve(distances.size());
   for(auto [ids, distance] : distances.asKeyValueRange()) {
-    query.addBindValue(ids.first);
-    query.addBindValue(ids.second);
-    query.addBindValue(distance);
-    if(!query.exec()) {
-      // Exit on failure.
-      qDebug() << "Failed to run query with parameters:" << ids.first << ids.second << distance;
-      return false;
-    }
+    from_ids.append(ids.first);
+    to_ids.append(ids.second);
+    values.append(distance);
+  }
+  query.addBindValue(profiles);
+  query.addBindValue(from_ids);
+  query.addBindValue(to_ids);
+  query.addBindValue(values);
+  if(!query.execBatch() || !db.commit()) {
+    // Exit on failure, leaving the table untouched.
+    qDebug() << "Failed to insert distance pairs:" << query.lastError().text() << db.lastError().text();
+    db.rollback();
+    return false;
   }
 
   // All pairs were inserted!
+  const double elapsed = 1e-9 * timer.nsecsElapsed();
+  qDebug() << "Inserted" << distances.size() << "distance pairs in" << elapsed << "s (" << distances.size() / std::max(elapsed, 1e-9) << "rows/s)";
   return true;
 }
 
@@ -275,7 +444,7 @@ bool openAndValidate(
     }
 
     // Does the table contain the expected columns?
-    QSqlRecord r = QSqlQuery("SELECT * FROM " + table_name).record();
+    QSqlRecord r = QSqlQuery("SELECT * FROM " + table_name, db).record();
     QSet<QString> existing_columns;
     for(int i=0; i<r.count(); i++) {
       existing_columns << r.fieldName(i).toLower();
@@ -290,6 +459,149 @@ bool openAndValidate(
 }
 
 
+// Helper function that adds the router profile to the Distances table, if it
+// is missing. SQLite cannot change the UNIQUE constraint of a table, so the
+// distances are copied into a new table; their router is unknown, so they are
+// tagged with an empty profile, which no router uses. Returns false if the
+// table could not be migrated.
+bool migrateDistances(
+  QSqlDatabase& db
+)
+{
+  if(db.record("Distances").contains("profile")) {
+    return true;
+  }
+
+  QStringList statements = {
+    "CREATE TABLE DistancesByProfile ("
+    "profile TEXT NOT NULL DEFAULT '', "
+    "from_id INTEGER, "
+    "to_id INTEGER, "
+    "distance REAL, "
+    "UNIQUE(profile, from_id, to_id), "
+    "FOREIGN KEY(from_id) REFERENCES Stations(id), "
+    "FOREIGN KEY(to_id) REFERENCES Stations(id)"
+    ");",
+    "INSERT INTO DistancesByProfile (profile, from_id, to_id, distance) SELECT '', from_id, to_id, distance FROM Distances;",
+    "DROP TABLE Distances;",
+    "ALTER TABLE DistancesByProfile RENAME TO Distances;"
+  };
+
+  // Replace the table, all or nothing.
+  qDebug() << "Adding router profiles to the distances";
+  QSqlQuery query(db);
+  if(!db.transaction()) {
+    return false;
+  }
+  for(const auto& statement : statements) {
+    if(!query.exec(statement)) {
+      qDebug() << "Failed to migrate distances:" << query.lastError().text();
+      db.rollback();
+      return false;
+    }
+  }
+  return db.commit();
+}
+
+
+// Helper function that creates the version of the stations (see
+// DatabaseManager::dataVersion()), if it does not exist. The version is a
+// record of the Metadata table, incremented by triggers. Returns false if
+// the table or the triggers could not be created.
+bool createStationsVersion(
+  QSqlDatabase& db
+)
+{
+  QStringList statements = {
+    "CREATE TABLE IF NOT EXISTS Metadata (key TEXT PRIMARY KEY, value INTEGER NOT NULL);",
+    "INSERT OR IGNORE INTO Metadata (key, value) VALUES ('stations_version', 0);"
+  };
+  for(QString event : {"INSERT", "UPDATE", "DELETE"}) {
+    statements.append(QString(
+      "CREATE TRIGGER IF NOT EXISTS StationsVersion%1 AFTER %2 ON Stations BEGIN "
+      "UPDATE Metadata SET value = value + 1 WHERE key = 'stations_version'; "
+      "END;"
+    ).arg(event.at(0) + event.mid(1).toLower(), event));
+  }
+
+  // Create the table and the triggers, all or nothing.
+  QSqlQuery query(db);
+  if(!db.transaction()) {
+    return false;
+  }
+  for(const auto& statement : statements) {
+    if(!query.exec(statement)) {
+      qDebug() << "Failed to create version of the stations:" << query.lastError().text();
+      db.rollback();
+      return false;
+    }
+  }
+  return db.commit();
+}
+
+
+// Helper function that creates the spatial index of the stations, if it does
+// not exist, and makes sure that it is in sync with the Stations table. The
+// index is an R*Tree virtual table, kept up to date by triggers. Returns false
+// if the index is not available (e.g., if SQLite was built without R*Tree).
+bool createSpatialIndex(
+  QSqlDatabase& db
+)
+{
+  QStringList statements = {
+    "CREATE VIRTUAL TABLE IF NOT EXISTS StationsRTree USING rtree("
+    "id, min_latitude, max_latitude, min_longitude, max_longitude"
+    ");",
+    "CREATE TRIGGER IF NOT EXISTS StationsRTreeInsert AFTER INSERT ON Stations BEGIN "
+    "INSERT OR REPLACE INTO StationsRTree VALUES (new.id, new.latitude, new.latitude, new.longitude, new.longitude); "
+    "END;",
+    "CREATE TRIGGER IF NOT EXISTS StationsRTreeUpdate AFTER UPDATE OF id, latitude, longitude ON Stations BEGIN "
+    "DELETE FROM StationsRTree WHERE id = old.id; "
+    "INSERT OR REPLACE INTO StationsRTree VALUES (new.id, new.latitude, new.latitude, new.longitude, new.longitude); "
+    "END;",
+    "CREATE TRIGGER IF NOT EXISTS StationsRTreeDelete AFTER DELETE ON Stations BEGIN "
+    "DELETE FROM StationsRTree WHERE id = old.id; "
+    "END;"
+  };
+
+  // Create the index and the triggers, all or nothing.
+  QSqlQuery query(db);
+  if(!db.transaction()) {
+    return false;
+  }
+  for(const auto& statement : statements) {
+    if(!query.exec(statement)) {
+      qDebug() << "Failed to create spatial index:" << query.lastError().text();
+      db.rollback();
+      return false;
+    }
+  }
+
+  // Fill the index if it has just been created, or if the stations were
+  // modified by someone that does not know about it.
+  if(
+    !query.exec("SELECT (SELECT COUNT(*) FROM Stations) = (SELECT COUNT(*) FROM StationsRTree);") ||
+    !query.next()
+  ) {
+    db.rollback();
+    return false;
+  }
+  if(!query.value(0).toBool()) {
+    qDebug() << "Rebuilding spatial index of the stations";
+    if(
+      !query.exec("DELETE FROM StationsRTree;") ||
+      !query.exec("INSERT INTO StationsRTree SELECT id, latitude, latitude, longitude, longitude FROM Stations;")
+    ) {
+      qDebug() << "Failed to fill spatial index:" << query.lastError().text();
+      db.rollback();
+      return false;
+    }
+  }
+
+  return db.commit();
+}
+
+
 QString DatabaseManager::loadDatabase() {
   // Sanity check to be able to use SQLite.
   if(!QSqlDatabase::drivers().contains("QSQLITE")) {
@@ -311,12 +623,16 @@ QString DatabaseManager::loadDatabase() {
   }
 
   // We located the required DB file: let's use it.
+  // This is the default connection, which is used as a template for the
+  // connections of each thread (see connection()). Connections wait for the
+  // locks held by other connections, rather than failing right away.
   QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE");
   db.setDatabaseName(db_path);
+  db.setConnectOptions(QString("QSQLITE_BUSY_TIMEOUT=%1").arg(BUSY_TIMEOUT_MS));
 
   // Try to open the database and check that there are the required tables.
   QMap<QString, QSet<QString>> expected_db{
-    {"Stations", {"id", "longitude", "latitude", "fuel_price"}},
+    {"Stations", {"id", "longitude", "latitude", "fuel_price", "price_date", "address"}},
     {"Distances", {"from_id", "to_id", "distance"}}
   };
   if(!openAndValidate(db, expected_db)) {
@@ -325,6 +641,45 @@ QString DatabaseManager::loadDatabase() {
     return "The database in incompatible, it does not have the required tables and columns";
   }
 
+  // Switch to WAL journaling, which is stored in the database: readers and
+  // writers do not block each other any more. Then, configure the connection
+  // (which is also the template for the connections of other threads).
+  QSqlQuery query(db);
+  if(!query.exec("PRAGMA journal_mode = WAL;") || !query.next() || query.value(0).toString().toLower() != "wal") {
+    qDebug() << "Failed to enable WAL journaling, readers and writers will block each other";
+  }
+  query.finish();
+  configureConnection(db);
+
+  // Distances are cached separately for each router profile; older databases
+  // need to be updated.
+  if(!migrateDistances(db)) {
+    QSqlDatabase::removeDatabase(db.connectionName());
+    return "Failed to add router profiles to the 'Distances' table";
+  }
+
+  // Keep track of changes to the stations.
+  has_stations_version_ = createStationsVersion(db);
+  if(!has_stations_version_) {
+    qDebug() << "Version of the stations not available, the snapshot will not be used";
+  }
+
+  // Use the spatial index, if possible; otherwise, queries still work, but
+  // they need to scan the whole table.
+  has_spatial_index_ = createSpatialIndex(db);
+  if(!has_spatial_index_) {
+    qDebug() << "Spatial index not available, GPS queries will be slower";
+  }
+
+  // Map the snapshot of the stations right away, writing it if needed.
+  database_id_ = QCryptographicHash::hash(
+    QFileInfo(db_path).canonicalFilePath().toUtf8(),
+    QCryptographicHash::Sha256
+  );
+  if(!snapshot()) {
+    qDebug() << "Snapshot of the stations not available, queries will use SQL";
+  }
+
   // Ok, the database was open!
   return QString();
 }
@@ -2,13 +2,22 @@
 #define DATABASE_MANAGER_HPP
 
 #include <memory>
+#include <optional>
 
+#include <QByteArray>
+#include <QElapsedTimer>
 #include <QList>
 #include <QMap>
+#include <QMutex>
 #include <QObject>
+#include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QString>
 #include <QStringList>
+#include <QVariant>
+
+
+class StationSnapshot;
 
 
 class DatabaseManager : public QObject {
@@ -16,16 +25,62 @@ class DatabaseManager : public QObject {
 
 public:
   /// Load the database from a file.
-  /** @return An empty string if the database was loaded successfully,
+  /** The database is switched to WAL journaling: readers see a consistent
+    * state of the database while it is being written (e.g., by the import
+    * scripts), and they do not block writers, nor are blocked by them.
+    *
+    * Alongside the database, a snapshot of the Stations table is kept in a
+    * binary file (see StationSnapshot), which is memory-mapped and used to
+    * answer read queries without going through SQL. The snapshot is written
+    * again whenever it was created from another database, or dataVersion()
+    * does not match the version it was created from. Once the database has
+    * been modified, this only happens after the version has stayed the same
+    * for SNAPSHOT_SETTLE_TIME_MS, so that imports that commit in batches do not
+    * cause a new snapshot for each batch. Writes always go to the database,
+    * and queries fall back to SQL while the snapshot is not available.
+    * @return An empty string if the database was loaded successfully,
     *   otherwise a string explaining what went wrong.
     */
   static QString loadDatabase();
 
+  /// Columns of the Stations table that can be requested by a query.
+  /** Columns are combined with '|', e.g., 'PRICE | LATITUDE | LONGITUDE':
+    * only the requested ones are selected by the query, and decoded.
+    */
+  enum Column {
+    ID = 0x01, ///< Database ID.
+    PRICE = 0x02, ///< Fuel price.
+    LATITUDE = 0x04, ///< GPS latitude.
+    LONGITUDE = 0x08, ///< GPS longitude.
+    DATE = 0x10, ///< Date of the price.
+    ADDRESS = 0x20, ///< Address.
+    ALL_COLUMNS = 0x3f ///< All of the above.
+  };
+  Q_DECLARE_FLAGS(Columns, Column)
+
+  /// Stations returned by a query, one list per column.
+  /** Only the lists of the requested columns are filled, all with the same
+    * size; the others are left empty.
+    */
+  struct StationData {
+    QList<int> ids; ///< Database IDs.
+    QList<double> prices; ///< Fuel prices.
+    QList<double> latitudes; ///< GPS latitudes.
+    QList<double> longitudes; ///< GPS longitudes.
+    QStringList dates; ///< Dates of the prices.
+    QStringList addresses; ///< Addresses.
+  };
+
   /// Auxiliary class to specify a set of filters when requesting data.
   class Filter {
   public:
     Filter() = default;
-    QSqlQuery compile() const;
+    /// Create a query that selects the records matching the filter.
+    /** Only the requested columns are selected, in the order of the Column
+      * flags, so that they can be read by index. The query is forward-only,
+      * and the number of records is not known in advance.
+      */
+    QSqlQuery compile(Columns columns = ALL_COLUMNS) const;
     bool setGPSRange(
       double min_latitude,
       double max_latitude,
@@ -33,105 +88,143 @@ public:
       double max_longitude
     );
     bool setPriceRange(double min_price, double max_price);
+    /// Tell if a station matches the filter.
+    /** This is the same condition used by compile(), evaluated in C++.
+      */
+    bool contains(double latitude, double longitude, double price) const;
+    /// Retrieve the latitude range of the filter.
+    /** @return false if the filter does not constrain latitudes.
+      */
+    bool latitudeRange(double& min_latitude, double& max_latitude) const;
     // bool setDateRange(int max_days); // TODO!
   private:
-    std::unique_ptr<double> min_latitude = nullptr;
-    std::unique_ptr<double> max_latitude = nullptr;
-    std::unique_ptr<double> min_longitude = nullptr;
-    std::unique_ptr<double> max_longitude = nullptr;
-    std::unique_ptr<double> min_price = nullptr;
-    std::unique_ptr<double> max_price = nullptr;
-    // std::unique_ptr<string> min_date = nullptr; // TODO!
+    std::optional<double> min_latitude;
+    std::optional<double> max_latitude;
+    std::optional<double> min_longitude;
+    std::optional<double> max_longitude;
+    std::optional<double> min_price;
+    std::optional<double> max_price;
+    // std::optional<QString> min_date; // TODO!
+
+    /// Create the SQL condition corresponding to this filter.
+    /** @param[out] args Map to which the values of the placeholders are added.
+      * @return A condition to be used in a WHERE clause. If the filter has no
+      *   constraints, the condition is simply '1'.
+      */
+    QString condition(QMap<QString, QVariant>& args) const;
   };
 
+  /// Largest number of IDs looked up by a single query in stationsFromIds().
+  static constexpr int IDS_PER_QUERY = 500;
+
+  /// Time, in ms, that a connection waits for a locked database.
+  static constexpr int BUSY_TIMEOUT_MS = 5000;
+
+  /// Size, in pages, of the WAL file that triggers a checkpoint.
+  static constexpr int WAL_AUTOCHECKPOINT_PAGES = 1000;
+
+  /// Size, in bytes, to which the WAL file is truncated after a checkpoint.
+  static constexpr qint64 WAL_SIZE_LIMIT_BYTES = 64 * 1024 * 1024;
+
+  /// Time, in ms, the data version must stay the same before the snapshot is written again.
+  static constexpr qint64 SNAPSHOT_SETTLE_TIME_MS = 2000;
+
+  /// Retrieve the database connection of the current thread.
+  /** Connections cannot be shared among threads, so each thread gets its own
+    * one: it is created on first use, as a clone of the default connection
+    * opened by loadDatabase(), and removed when the thread finishes. All
+    * queries of this class use it, so that stations can be fetched from any
+    * thread, e.g., by planner workers.
+    * @return The connection; it might not be open if an error occurred.
+    */
+  static QSqlDatabase connection();
+
+  /// Tell if GPS ranges can be looked up in the spatial index of the stations.
+  /** The index (an R*Tree table named StationsRTree) is created, or brought
+    * up to date, by loadDatabase().
+    */
+  static inline bool hasSpatialIndex() { return has_spatial_index_; }
+
   /// Create a new DatabaseManager.
   explicit inline DatabaseManager(QObject* parent = nullptr) : QObject(parent) { }
 
   /// Retrieve a list of stations given their IDs.
   /** @param[in] ids A list of IDs to locate in the database.
-    * @param[out] prices Pointer to a list to be filled with stations prices.
-    *   It can be nullptr, in which case prices are not retrieved.
-    * @param[out] latitudes Pointer to a list to be filled with stations
-    *   latitudes. It can be nullptr, in which case latitudes are not
-    *   retrieved.
-    * @param[out] longitudes Pointer to a list to be filled with stations
-    *   longitudes. It can be nullptr, in which case longitudes are not
-    *   retrieved.
-    * @param[out] dates Pointer to a list to be filled with stations dates. It
-    *   can be nullptr, in which case dates are not retrieved.
-    * @param[out] addresses Pointer to a list to be filled with stations
-    *   addresses. It can be nullptr, in which case addresses are not
-    *   retrieved.
-    * @return The method scans the database ID-by-ID, and returns false
-    *   immediately if an ID is missing (or if a database issue is encoutered).
-    *   If all stations were found, the function returns true.
+    * @param[in] columns Columns to be retrieved.
+    * @param[out] stations The requested columns of the stations, in the order
+    *   of the input IDs.
+    * Stations are read from the snapshot, if available (see loadDatabase()).
+    * Otherwise, only the requested columns are selected, and IDs are looked
+    * up in chunks of IDS_PER_QUERY, one query per chunk.
+    * @return The method returns false if an ID is missing (or if a database
+    *   issue is encoutered), in which case the output lists are cleared. If
+    *   all stations were found, the function returns true.
     */
   bool stationsFromIds(
     const QList<int>& ids,
-    QList<double>* prices,
-    QList<double>* latitudes,
-    QList<double>* longitudes,
-    QStringList* dates,
-    QStringList* addresses
+    Columns columns,
+    StationData& stations
   );
 
   /// Retrieve all stations from the database, given some conditions.
-  /** @param[in] filter A DatabaseManager::Filter instance that sets conditions
+  /** Stations are read from the snapshot, if available (see loadDatabase());
+    * otherwise, only the requested columns are selected.
+    * @param[in] filter A DatabaseManager::Filter instance that sets conditions
     *   on the records to be fetched.
-    * @param[out] ids Pointer to a list to be filled with stations IDs. It can
-    *   be nullptr, in which case IDs are not retrieved.
-    * @param[out] prices Pointer to a list to be filled with stations prices.
-    *   It can be nullptr, in which case prices are not retrieved.
-    * @param[out] latitudes Pointer to a list to be filled with stations
-    *   latitudes. It can be nullptr, in which case latitudes are not
-    *   retrieved.
-    * @param[out] longitudes Pointer to a list to be filled with stations
-    *   longitudes. It can be nullptr, in which case longitudes are not
-    *   retrieved.
-    * @param[out] dates Pointer to a list to be filled with stations dates. It
-    *   can be nullptr, in which case dates are not retrieved.
-    * @param[out] addresses Pointer to a list to be filled with stations
-    *   addresses. It can be nullptr, in which case addresses are not
-    *   retrieved.
+    * @param[in] columns Columns to be retrieved.
+    * @param[out] stations The requested columns of the stations.
     * @return The method returns false if there was an issue accessing the
     *   database. It will return true if data could be retrieved. Note that if
-    *   no station matches the given filter, the method returns true as this is
-    *   not a database access issue. In this case, all output lists will simply
+    *   no station matches the filter, the method returns true as this is not
+    *   a database access issue. In this case, all output lists will simply
     *   have zero-size.
     */
   bool findStations(
     const Filter& filter,
-    QList<int>* ids,
-    QList<double>* prices,
-    QList<double>* latitudes,
-    QList<double>* longitudes,
-    QStringList* dates,
-    QStringList* addresses
+    Columns columns,
+    StationData& stations
   );
 
   /// Retrieve all stations from the database.
   /** @see findStations().
     */
   inline bool allStations(
-    QList<int>* ids,
-    QList<double>* prices,
-    QList<double>* latitudes,
-    QList<double>* longitudes,
-    QStringList* dates,
-    QStringList* addresses
-    ) { return findStations(Filter(), ids, prices, latitudes, longitudes, dates, addresses); }
+    Columns columns,
+    StationData& stations
+  ) { return findStations(Filter(), columns, stations); }
+
+  /// Retrieve a number that changes whenever the stations are modified.
+  /** The number is stored in the Metadata table, and it is incremented by
+    * triggers (created by loadDatabase()) each time a station is added,
+    * modified or removed, by any connection (e.g., when prices are updated
+    * by the import scripts). It can be used to tell if stations read earlier
+    * are still up to date, and it does not change when distances are cached.
+    * If the triggers could not be created, no version is available, and the
+    * snapshot of the stations is not used.
+    * @param[out] version The current version.
+    * @return false if an error occurred, or if no version is available; true
+    *   otherwise.
+    */
+  static bool dataVersion(qint64& version);
 
   /// Retrieve all distance pairs for the given IDs.
-  /** @param ids A list of IDs for which pairs are to be fetched. All
+  /** The IDs are loaded into a temporary table, which is joined with the
+    * distances on their (profile, from_id, to_id) index: the query does not
+    * depend on the number of IDs.
+    * @param ids A list of IDs for which pairs are to be fetched. All
     *   possible combinations will be looked for.
-    * @param[out] distances A map whose elements are in the form
-    *   {(ID1, ID2): d}, where the key is a pair of IDs and d is the distance
-    *   from ID1 to ID2.
+    * @param profile Profile of the router the distances were computed with
+    *   (see RouterService::profile()); distances cached by other routers are
+    *   ignored.
+    * @param[out] distances A square matrix, such that distances[i][j] is the
+    *   distance from ids[i] to ids[j], or -1 if the pair is not in the
+    *   database.
     * @return false if an error occurred, true otherwise.
     */
   bool distancePairs(
     const QList<int>& ids,
-    QMap<QPair<int,int>,double>& distances
+    const QString& profile,
+    QList<QList<double>>& distances
   );
 
   /// Add or update distance pairs for the given IDs.
@@ -140,11 +233,63 @@ public:
     *   from ID1 to ID2. If an entry for the pair (ID1, ID2) already exists in
     *   the database, the corresponding distance is updated. If no such entry
     *   exists, a new one is added.
+    * @param profile Profile of the router the distances were computed with
+    *   (see RouterService::profile()).
+    *
+    * All pairs are written in a single transaction: if an error occurs, none
+    * of them is.
     * @return false if an error occurred, true otherwise.
     */
   bool insertPairs(
-    const QMap<QPair<int,int>,double>& distances
+    const QMap<QPair<int,int>,double>& distances,
+    const QString& profile
+  );
+
+private:
+  inline static bool has_spatial_index_ = false; ///< Set by loadDatabase().
+  inline static bool has_stations_version_ = false; ///< Set by loadDatabase().
+  inline static QByteArray database_id_; ///< Identity of the database, stored in the snapshot; set by loadDatabase().
+  inline static std::shared_ptr<const StationSnapshot> snapshot_; ///< Current snapshot, if any.
+  inline static std::optional<qint64> failed_snapshot_version_; ///< Version for which the snapshot could not be written.
+  inline static std::optional<qint64> pending_snapshot_version_; ///< Latest version seen while the snapshot is outdated.
+  inline static QElapsedTimer pending_snapshot_timer_; ///< Time since pending_snapshot_version_ was first seen.
+  inline static QMutex snapshot_mutex_; ///< Protects the snapshot.
+
+  /// Retrieve the snapshot of the stations, writing it again if needed.
+  /** @return The snapshot, or nullptr if it is not available (or outdated,
+    *   and not yet written again).
+    */
+  static std::shared_ptr<const StationSnapshot> snapshot();
+
+  /// Implementation of findStations() based on SQL queries.
+  static bool queryStations(
+    const Filter& filter,
+    Columns columns,
+    StationData& stations
   );
+
+  /// Implementation of findStations() based on the snapshot.
+  static void snapshotStations(
+    const StationSnapshot& snapshot,
+    const Filter& filter,
+    Columns columns,
+    StationData& stations
+  );
+
+  /// Implementation of stationsFromIds() based on the snapshot.
+  static bool snapshotStationsFromIds(
+    const StationSnapshot& snapshot,
+    const QList<int>& ids,
+    Columns columns,
+    StationData& stations
+  );
+
+  /// Names of the SQL columns corresponding to the given flags.
+  /** Names are in the order of the flags.
+    */
+  static QStringList columnNames(Columns columns);
 };
 
+Q_DECLARE_OPERATORS_FOR_FLAGS(DatabaseManager::Columns)
+
 #endif // DATABASE_MANAGER_HPP
@@ -1,16 +1,12 @@
 #include "database_manager.hpp"
 
 
-QSqlQuery DatabaseManager::Filter::compile() const
+QString DatabaseManager::Filter::condition(
+  QMap<QString, QVariant>& args
+) const
 {
-  // "Base" statement to select elements from the Stations table.
-  QString select_query_string = "SELECT * FROM Stations";
-
-  // Query parameters, to be added using QSqlQuery::bindValue().
-  QMap<QString, QVariant> query_args;
-
-  // Create a list of conditions to be appended in the form of:
-  //   WHERE condition1 AND condition2 AND ...
+  // Create a list of conditions to be joined in the form of:
+  //   condition1 AND condition2 AND ...
   QStringList conditions;
 
   // Helper function: define a new condition for a given column. If the minimum
@@ -20,43 +16,66 @@ QSqlQuery DatabaseManager::Filter::compile() const
   auto add_range = [&](const QString& column, const auto& min, const auto& max)
   {
     // Do not add "null" constraints.
-    if(min == nullptr) {
+    if(!min) {
       return;
     }
 
     // Add the constraint either as an equality, or a range.
+    QString placeholder = ":" + column;
     if(*min == *max) {
-      conditions.append(QString("%1 = :%1").arg(column));
-      query_args[":column"] = *min;
+      conditions.append(QString("%1 = %2").arg(column, placeholder));
+      args[placeholder] = *min;
     }
     else {
-      conditions.append(QString("%1 BETWEEN :%1_min AND :%1_max").arg(column));
-      query_args[":" + column + "_min"] = *min;
-      query_args[":" + column + "_max"] = *max;
+      conditions.append(QString("%1 BETWEEN %2_min AND %2_max").arg(column, placeholder));
+      args[placeholder + "_min"] = *min;
+      args[placeholder + "_max"] = *max;
     }
   };
 
+  // If possible, look up GPS ranges in the spatial index first. Its boxes are
+  // stored with reduced precision, so they are only used to select a superset
+  // of the records; the exact ranges are checked below.
+  if(min_latitude && hasSpatialIndex()) {
+    QString placeholder = ":rtree";
+    conditions.append(QString(
+      "id IN (SELECT id FROM StationsRTree WHERE"
+      " max_latitude >= %1_lat_min AND min_latitude <= %1_lat_max"
+      " AND max_longitude >= %1_lon_min AND min_longitude <= %1_lon_max)"
+    ).arg(placeholder));
+    args[placeholder + "_lat_min"] = *min_latitude;
+    args[placeholder + "_lat_max"] = *max_latitude;
+    args[placeholder + "_lon_min"] = *min_longitude;
+    args[placeholder + "_lon_max"] = *max_longitude;
+  }
+
   // Add constraints as needed.
   add_range("latitude", min_latitude, max_latitude);
   add_range("longitude", min_longitude, max_longitude);
   add_range("fuel_price", min_price, max_price);
 
-  // If there are conditions, add them to the select query.
-  if(!conditions.isEmpty()) {
-    select_query_string += " WHERE " + conditions.join(" AND ");
-  }
+  // A filter without constraints matches all records.
+  return conditions.isEmpty() ? "1" : conditions.join(" AND ");
+}
+
 
-  // Now create the "full" query, which fetches the desired records, counts
-  // them, and returns the record alongside the count. This is to workaround
-  // the fact that QSqlQuery::size() is a no-op for SQLite databases.
-  QSqlQuery query;
-  query.prepare(
-    QString(
-      "WITH filtered_stations AS (" + select_query_string + ")"
-      " "
-      "SELECT *, (SELECT COUNT(*) FROM filtered_stations) AS query_size FROM filtered_stations;"
-    )
-  );
+QSqlQuery DatabaseManager::Filter::compile(Columns columns) const
+{
+  // Query parameters, to be added using QSqlQuery::bindValue().
+  QMap<QString, QVariant> query_args;
+  QString where = condition(query_args);
+
+  // Select the requested columns of the records from the Stations table, in
+  // the order of the Column flags. The number of records is not counted in
+  // advance: this would need to evaluate the conditions twice, while the
+  // caller can simply grow its lists as records are read.
+  QStringList select = columnNames(columns);
+  if(select.isEmpty()) {
+    select.append("id");
+  }
+  QSqlQuery query(connection());
+  query.setForwardOnly(true);
+  query.prepare(QString("SELECT %1 FROM Stations WHERE %2;").arg(select.join(", "), where));
 
   // Bind values to the query - this should be safe against injections.
   for(const auto& [key, val] : query_args.asKeyValueRange()) {
@@ -78,10 +97,10 @@ bool DatabaseManager::Filter::setGPSRange(
   if(min_latitude > max_latitude || min_longitude > max_longitude)
     return false;
 
-  this->min_latitude = std::make_unique<double>(min_latitude);
-  this->max_latitude = std::make_unique<double>(max_latitude);
-  this->min_longitude = std::make_unique<double>(min_longitude);
-  this->max_longitude = std::make_unique<double>(max_longitude);
+  this->min_latitude = min_latitude;
+  this->max_latitude = max_latitude;
+  this->min_longitude = min_longitude;
+  this->max_longitude = max_longitude;
   return true;
 }
 
@@ -94,7 +113,37 @@ bool DatabaseManager::Filter::setPriceRange(
   if(min_price > max_price || min_price < 0)
     return false;
 
-  this->min_price = std::make_unique<double>(min_price);
-  this->max_price = std::make_unique<double>(max_price);
+  this->min_price = min_price;
+  this->max_price = max_price;
+  return true;
+}
+
+
+bool DatabaseManager::Filter::contains(
+  double latitude,
+  double longitude,
+  double price
+) const
+{
+  // Same as the 'BETWEEN' conditions of the SQL query.
+  auto in_range = [](double value, const auto& min, const auto& max) {
+    return !min || (*min <= value && value <= *max);
+  };
+  return in_range(latitude, min_latitude, max_latitude)
+    && in_range(longitude, min_longitude, max_longitude)
+    && in_range(price, min_price, max_price);
+}
+
+
+bool DatabaseManager::Filter::latitudeRange(
+  double& min_latitude,
+  double& max_latitude
+) const
+{
+  if(!this->min_latitude) {
+    return false;
+  }
+  min_latitude = *this->min_latitude;
+  max_latitude = *this->max_latitude;
   return true;
 }
@@ -0,0 +1,173 @@
+#include "database_manager.hpp"
+
+#include "station_snapshot.hpp"
+
+#include <QDir>
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <QtDebug>
+#include <algorithm>
+#include <numeric>
+
+
+std::shared_ptr<const StationSnapshot> DatabaseManager::snapshot()
+{
+  // Nothing to do if the current snapshot was created from this version of
+  // this database.
+  qint64 version;
+  if(!dataVersion(version)) {
+    return nullptr;
+  }
+  QMutexLocker lock(&snapshot_mutex_);
+  auto is_current = [&](const StationSnapshot& stations) {
+    return stations.sourceId() == database_id_ && stations.sourceVersion() == version;
+  };
+  if(snapshot_ && is_current(*snapshot_)) {
+    return snapshot_;
+  }
+  if(failed_snapshot_version_ == version) {
+    return nullptr;
+  }
+
+  // If a snapshot was already made, the database is being modified, possibly
+  // by an import that commits in batches: wait until the version stops
+  // changing, rather than writing a snapshot for each batch. Meanwhile,
+  // queries use SQL.
+  if(snapshot_ || failed_snapshot_version_) {
+    if(pending_snapshot_version_ != version) {
+      pending_snapshot_version_ = version;
+      pending_snapshot_timer_.start();
+    }
+    if(pending_snapshot_timer_.elapsed() < SNAPSHOT_SETTLE_TIME_MS) {
+      return nullptr;
+    }
+  }
+  pending_snapshot_version_.reset();
+
+  // Try the snapshot on disk first: it might have been written by an earlier
+  // run of the application.
+  QString directory = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+  QString path = QDir(directory).filePath("stations.snapshot");
+  auto stations = std::make_shared<StationSnapshot>();
+  if(stations->open(path) && is_current(*stations)) {
+    snapshot_ = stations;
+    return snapshot_;
+  }
+
+  // Otherwise, write a new one. The mappings of the file are released first,
+  // since some systems do not allow to replace a mapped file (note that the
+  // current snapshot is still mapped if someone else holds a reference).
+  stations->close();
+  snapshot_.reset();
+  qDebug() << "Writing snapshot of the stations to" << path;
+
+  // The version and the stations are read in the same transaction, so that
+  // they are consistent even if the database is being modified.
+  StationData all;
+  QSqlDatabase db = connection();
+  bool ok = db.transaction();
+  ok = ok && dataVersion(version);
+  ok = ok && queryStations(Filter(), ALL_COLUMNS, all);
+  db.commit();
+  if(
+    !ok ||
+    !QDir().mkpath(directory) ||
+    !StationSnapshot::write(path, database_id_, version, all.ids, all.prices, all.latitudes, all.longitudes, all.dates, all.addresses) ||
+    !stations->open(path)
+  ) {
+    qDebug() << "Failed to create snapshot of the stations";
+    failed_snapshot_version_ = version;
+    return nullptr;
+  }
+  failed_snapshot_version_.reset();
+  snapshot_ = stations;
+  return snapshot_;
+}
+
+
+void DatabaseManager::snapshotStations(
+  const StationSnapshot& snapshot,
+  const Filter& filter,
+  Columns columns,
+  StationData& stations
+)
+{
+  // Use the latitude index to find the candidate stations, if the filter has
+  // a latitude range; otherwise, all stations must be checked.
+  QList<qint64> candidates;
+  double min_latitude, max_latitude;
+  if(filter.latitudeRange(min_latitude, max_latitude)) {
+    candidates = snapshot.inLatitudeRange(min_latitude, max_latitude);
+  }
+  else {
+    candidates.resize(snapshot.size());
+    std::iota(candidates.begin(), candidates.end(), 0);
+  }
+
+  // Check the candidates against the filter. Stations are sorted by ID, as in
+  // the database.
+  for(qint64 i : candidates) {
+    if(!filter.contains(snapshot.latitude(i), snapshot.longitude(i), snapshot.price(i))) {
+      continue;
+    }
+
+    // Copy the requested columns of the station.
+    if(columns.testFlag(ID))
+      stations.ids.append(snapshot.id(i));
+    if(columns.testFlag(PRICE))
+      stations.prices.append(snapshot.price(i));
+    if(columns.testFlag(LATITUDE))
+      stations.latitudes.append(snapshot.latitude(i));
+    if(columns.testFlag(LONGITUDE))
+      stations.longitudes.append(snapshot.longitude(i));
+    if(columns.testFlag(DATE))
+      stations.dates.append(snapshot.date(i));
+    if(columns.testFlag(ADDRESS))
+      stations.addresses.append(snapshot.address(i));
+  }
+}
+
+
+bool DatabaseManager::snapshotStationsFromIds(
+  const StationSnapshot& snapshot,
+  const QList<int>& ids,
+  Columns columns,
+  StationData& stations
+)
+{
+  // All lists have the same size as the IDs, and are filled by position.
+  auto resize = [&](qsizetype size) {
+    auto resize_list = [&](Column column, auto& list) {
+      list.resize(columns.testFlag(column) ? size : 0);
+    };
+    resize_list(ID, stations.ids);
+    resize_list(PRICE, stations.prices);
+    resize_list(LATITUDE, stations.latitudes);
+    resize_list(LONGITUDE, stations.longitudes);
+    resize_list(DATE, stations.dates);
+    resize_list(ADDRESS, stations.addresses);
+  };
+  resize(ids.size());
+
+  for(int k=0; k<ids.size(); k++) {
+    const qint64 i = snapshot.find(ids[k]);
+    if(i < 0) {
+      qDebug() << "Could not find station" << ids[k] << "in the snapshot";
+      resize(0);
+      return false;
+    }
+    if(columns.testFlag(ID))
+      stations.ids[k] = ids[k];
+    if(columns.testFlag(PRICE))
+      stations.prices[k] = snapshot.price(i);
+    if(columns.testFlag(LATITUDE))
+      stations.latitudes[k] = snapshot.latitude(i);
+    if(columns.testFlag(LONGITUDE))
+      stations.longitudes[k] = snapshot.longitude(i);
+    if(columns.testFlag(DATE))
+      stations.dates[k] = snapshot.date(i);
+    if(columns.testFlag(ADDRESS))
+      stations.addresses[k] = snapshot.address(i);
+  }
+  return true;
+}
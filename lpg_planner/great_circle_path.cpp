@@ -0,0 +1,128 @@
+#include "great_circle_path.hpp"
+
+#include "math_utilities.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+
+GreatCirclePath::GreatCirclePath(
+  const QList<double>& waypoints_latitudes,
+  const QList<double>& waypoints_longitudes
+) : latitudes_(waypoints_latitudes)
+  , longitudes_(waypoints_longitudes)
+{
+  if(!isValid() || latitudes_.size() < 2) {
+    return;
+  }
+
+  // Only the length of each arc is calculated in advance.
+  auto lat = Eigen::Map<const Eigen::ArrayXd>(latitudes_.data(), latitudes_.size());
+  auto lon = Eigen::Map<const Eigen::ArrayXd>(longitudes_.data(), longitudes_.size());
+  const qsizetype n = latitudes_.size();
+  leg_lengths_.resize(n-1);
+  Eigen::Map<Eigen::ArrayXd>(leg_lengths_.data(), n-1) = math_utilities::haversineDistance(
+    lat.head(n-1), lon.head(n-1), lat.tail(n-1), lon.tail(n-1)
+  );
+  for(double d : leg_lengths_) {
+    length_ += d;
+  }
+}
+
+
+qsizetype GreatCirclePath::pieces(
+  qsizetype leg,
+  double resolution_km
+) const
+{
+  return std::max<qsizetype>(1, static_cast<qsizetype>(std::ceil(leg_lengths_[leg] / resolution_km)));
+}
+
+
+qsizetype GreatCirclePath::size(
+  double resolution_km
+) const
+{
+  if(!isValid() || latitudes_.size() < 2) {
+    return isValid() ? latitudes_.size() : 0;
+  }
+
+  // All pieces of all arcs, plus the very last waypoint.
+  qsizetype count = 1;
+  for(qsizetype leg=0; leg<leg_lengths_.size(); leg++) {
+    count += pieces(leg, resolution_km);
+  }
+  return count;
+}
+
+
+void GreatCirclePath::point(
+  qsizetype leg,
+  double fraction,
+  double& latitude,
+  double& longitude
+) const
+{
+  // Spherical linear interpolation between the unit vectors corresponding to
+  // the extremities of the arc.
+  using math_utilities::TO_DEG;
+  using math_utilities::TO_RAD;
+  const double lat1 = TO_RAD * latitudes_[leg];
+  const double lon1 = TO_RAD * longitudes_[leg];
+  const double lat2 = TO_RAD * latitudes_[leg+1];
+  const double lon2 = TO_RAD * longitudes_[leg+1];
+  const double delta = leg_lengths_[leg] / math_utilities::EARTH_RADIUS_KM;
+
+  // For very short arcs, linear interpolation is accurate enough (and it
+  // avoids dividing by sin(delta) ~ 0).
+  if(delta < 1e-9) {
+    latitude = latitudes_[leg] * (1-fraction) + latitudes_[leg+1] * fraction;
+    longitude = longitudes_[leg] * (1-fraction) + longitudes_[leg+1] * fraction;
+    return;
+  }
+
+  const double a = std::sin((1-fraction) * delta) / std::sin(delta);
+  const double b = std::sin(fraction * delta) / std::sin(delta);
+  const double x = a * std::cos(lat1) * std::cos(lon1) + b * std::cos(lat2) * std::cos(lon2);
+  const double y = a * std::cos(lat1) * std::sin(lon1) + b * std::cos(lat2) * std::sin(lon2);
+  const double z = a * std::sin(lat1) + b * std::sin(lat2);
+  latitude = TO_DEG * std::atan2(z, std::sqrt(x*x + y*y));
+  longitude = TO_DEG * std::atan2(y, x);
+}
+
+
+void GreatCirclePath::sample(
+  double resolution_km,
+  QList<double>& latitudes,
+  QList<double>& longitudes
+) const
+{
+  // Allocate memory once, since the number of points is known in advance.
+  const qsizetype n = size(resolution_km);
+  latitudes.resize(n);
+  longitudes.resize(n);
+  if(n < 2) {
+    for(qsizetype i=0; i<n; i++) {
+      latitudes[i] = latitudes_[i];
+      longitudes[i] = longitudes_[i];
+    }
+    return;
+  }
+
+  // Generate points along each arc. Skip the last one, since it corresponds
+  // to the first point of the next arc.
+  qsizetype i = 0;
+  for(qsizetype leg=0; leg<leg_lengths_.size(); leg++) {
+    const qsizetype n_pieces = pieces(leg, resolution_km);
+    latitudes[i] = latitudes_[leg];
+    longitudes[i] = longitudes_[leg];
+    i++;
+    for(qsizetype k=1; k<n_pieces; k++, i++) {
+      point(leg, static_cast<double>(k) / n_pieces, latitudes[i], longitudes[i]);
+    }
+  }
+
+  // Add the very last waypoint.
+  latitudes[i] = latitudes_.back();
+  longitudes[i] = longitudes_.back();
+}
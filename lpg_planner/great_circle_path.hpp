@@ -0,0 +1,67 @@
+#ifndef GREAT_CIRCLE_PATH_HPP
+#define GREAT_CIRCLE_PATH_HPP
+
+#include <QList>
+
+
+/// Path made of great-circle arcs between consecutive waypoints.
+/** Only the waypoints and the length of each arc are stored. Intermediate
+  * points are generated on demand, at the resolution chosen by the consumer,
+  * so that consumers that only need the endpoints or the length of the path
+  * never materialize any point.
+  */
+class GreatCirclePath {
+public:
+  /// Create a path passing through the given waypoints.
+  /** @param waypoints_latitudes Latitudes of the waypoints.
+    * @param waypoints_longitudes Longitudes of the waypoints. If the size does
+    *   not match that of waypoints_latitudes, the path is invalid.
+    */
+  GreatCirclePath(
+    const QList<double>& waypoints_latitudes,
+    const QList<double>& waypoints_longitudes
+  );
+
+  /// Tell if the waypoints used to create the path were consistent.
+  inline bool isValid() const { return latitudes_.size() == longitudes_.size(); }
+
+  /// Number of waypoints.
+  inline qsizetype waypointCount() const { return latitudes_.size(); }
+
+  /// Total length of the path, in km.
+  inline double length() const { return length_; }
+
+  /// Number of points generated by sample() with the given resolution.
+  qsizetype size(double resolution_km) const;
+
+  /// Calculate the point at a given fraction of the i-th arc.
+  /** @param leg Index of the arc, from waypoint leg to waypoint leg+1.
+    * @param fraction Position along the arc, from 0 (first waypoint) to 1
+    *   (second waypoint).
+    * @param[out] latitude Latitude of the point.
+    * @param[out] longitude Longitude of the point.
+    */
+  void point(qsizetype leg, double fraction, double& latitude, double& longitude) const;
+
+  /// Generate points along the path.
+  /** Each arc is split into the smallest number of pieces whose length does
+    * not exceed the given resolution. All waypoints are part of the output.
+    * @param resolution_km Maximum distance between consecutive points.
+    * @param[out] latitudes Latitudes of the points. Previous content is
+    *   discarded.
+    * @param[out] longitudes Longitudes of the points. Previous content is
+    *   discarded.
+    */
+  void sample(double resolution_km, QList<double>& latitudes, QList<double>& longitudes) const;
+
+private:
+  QList<double> latitudes_; ///< Latitudes of the waypoints.
+  QList<double> longitudes_; ///< Longitudes of the waypoints.
+  QList<double> leg_lengths_; ///< Length of each arc, in km.
+  double length_ = 0.0; ///< Total length, in km.
+
+  /// Number of pieces the i-th arc is split into, given a resolution.
+  qsizetype pieces(qsizetype leg, double resolution_km) const;
+};
+
+#endif // GREAT_CIRCLE_PATH_HPP
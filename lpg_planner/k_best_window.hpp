@@ -0,0 +1,88 @@
+#ifndef K_BEST_WINDOW_HPP
+#define K_BEST_WINDOW_HPP
+
+#include <functional>
+#include <vector>
+
+
+/// Sliding window that keeps track of the k best elements it contains.
+/** Elements are pushed at the back and popped from the front, like in a
+  * queue, and at any time the k best elements in the window can be queried.
+  *
+  * The window is implemented as a pair of stacks (a "two-stack queue"): each
+  * entry of a stack stores, alongside its value, the k best elements among
+  * itself and all entries below it. Pushing and querying cost O(k), while
+  * popping costs O(k) amortized, since each element is moved from one stack
+  * to the other at most once. With k = 1 this is equivalent to the classic
+  * monotonic-deque sliding minimum.
+  *
+  * Example:
+  * ```
+  * KBestWindow<double> window(2);
+  * window.push(3.0);
+  * window.push(1.0);
+  * window.push(2.0);
+  * window.best(); // {1.0, 2.0}
+  * window.pop();
+  * window.pop();
+  * window.best(); // {2.0}
+  * ```
+  */
+template<class T, class Compare = std::less<T>>
+class KBestWindow {
+public:
+  /// Create an empty window.
+  /** @param k Number of elements to be returned by best(). It should be
+    *   positive.
+    * @param compare Strict weak ordering: compare(a, b) must be true if a is
+    *   better than b.
+    */
+  explicit KBestWindow(unsigned int k, Compare compare = Compare());
+
+  /// Add an element at the back of the window.
+  void push(const T& value);
+
+  /// Remove the element at the front of the window.
+  /** The window must not be empty.
+    */
+  void pop();
+
+  /// Number of elements in the window.
+  inline std::size_t size() const { return front_.size() + back_.size(); }
+
+  /// Tell if the window contains no elements.
+  inline bool empty() const { return front_.empty() && back_.empty(); }
+
+  /// Remove all elements from the window.
+  void clear();
+
+  /// Return the (at most) k best elements in the window.
+  /** @return The best elements, sorted from the best to the worst.
+    */
+  std::vector<T> best() const;
+
+private:
+  /// Sorted list of the (at most) k best elements of some set.
+  using Summary = std::vector<T>;
+
+  /// Element of one of the two stacks.
+  struct Entry {
+    T value; ///< Value of the element.
+    Summary best; ///< Best elements among this one and those below it.
+  };
+
+  unsigned int k_; ///< Number of elements to keep track of.
+  Compare compare_; ///< Ordering used to rank elements.
+  std::vector<Entry> front_; ///< Stack whose top is the oldest element.
+  std::vector<Entry> back_; ///< Stack whose top is the newest element.
+
+  /// Return a copy of the summary with an extra element inserted.
+  Summary insert(const Summary& summary, const T& value) const;
+
+  /// Merge two summaries, keeping only the best k elements.
+  Summary merge(const Summary& a, const Summary& b) const;
+};
+
+#include "k_best_window.hxx"
+
+#endif // K_BEST_WINDOW_HPP
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "k_best_window.hpp"
+
+#include <algorithm>
+
+
+template<class T, class Compare>
+KBestWindow<T, Compare>::KBestWindow(
+  unsigned int k,
+  Compare compare
+) : k_(k)
+  , compare_(compare)
+{
+  // Nothing to do here.
+}
+
+
+template<class T, class Compare>
+void KBestWindow<T, Compare>::push(
+  const T& value
+)
+{
+  // The new element is on top of the "back" stack, so its summary is the one
+  // below it plus the element itself.
+  Summary best = insert(back_.empty() ? Summary() : back_.back().best, value);
+  back_.push_back({value, std::move(best)});
+}
+
+
+template<class T, class Compare>
+void KBestWindow<T, Compare>::pop()
+{
+  // If the "front" stack is empty, move all elements from the "back" one.
+  // This reverses their order, so that the oldest element ends up on top.
+  if(front_.empty()) {
+    while(!back_.empty()) {
+      const T& value = back_.back().value;
+      Summary best = insert(front_.empty() ? Summary() : front_.back().best, value);
+      front_.push_back({value, std::move(best)});
+      back_.pop_back();
+    }
+  }
+
+  front_.pop_back();
+}
+
+
+template<class T, class Compare>
+void KBestWindow<T, Compare>::clear()
+{
+  front_.clear();
+  back_.clear();
+}
+
+
+template<class T, class Compare>
+std::vector<T> KBestWindow<T, Compare>::best() const
+{
+  // The best elements in the window are the best among those in both stacks.
+  return merge(
+    front_.empty() ? Summary() : front_.back().best,
+    back_.empty() ? Summary() : back_.back().best
+  );
+}
+
+
+template<class T, class Compare>
+typename KBestWindow<T, Compare>::Summary KBestWindow<T, Compare>::insert(
+  const Summary& summary,
+  const T& value
+) const
+{
+  // Insert the value in the sorted list, then drop the worst element if the
+  // list has become too long.
+  Summary result;
+  result.reserve(summary.size() + 1);
+  auto position = std::upper_bound(summary.begin(), summary.end(), value, compare_);
+  result.insert(result.end(), summary.begin(), position);
+  result.push_back(value);
+  result.insert(result.end(), position, summary.end());
+  if(result.size() > k_) {
+    result.resize(k_);
+  }
+  return result;
+}
+
+
+template<class T, class Compare>
+typename KBestWindow<T, Compare>::Summary KBestWindow<T, Compare>::merge(
+  const Summary& a,
+  const Summary& b
+) const
+{
+  // Standard merge of two sorted lists, stopped after k elements.
+  Summary result;
+  result.reserve(std::min<std::size_t>(k_, a.size() + b.size()));
+  auto ia = a.begin();
+  auto ib = b.begin();
+  while(result.size() < k_ && (ia != a.end() || ib != b.end())) {
+    if(ib == b.end() || (ia != a.end() && !compare_(*ib, *ia))) {
+      result.push_back(*ia++);
+    }
+    else {
+      result.push_back(*ib++);
+    }
+  }
+  return result;
+}
@@ -1,10 +1,42 @@
 #include "lpg_planner.hpp"
 
+#include "great_circle_path.hpp"
+#include "k_best_window.hpp"
 #include "math_utilities.hpp"
 
 #include <Eigen/Dense>
 #include <EigenOpt/simplex.hpp>
+#include <QElapsedTimer>
+#include <QtConcurrent>
+#include <cmath>
 #include <iostream>
+#include <limits>
+
+
+/// Run a function over the range [0, n) on the global thread pool.
+/** The range is split into chunks of (at most) 'grain' consecutive indices,
+  * and body(begin, end) is called once per chunk. The call returns when all
+  * chunks have been processed. Since chunks do not overlap, the body can
+  * write results to preallocated arrays without any synchronization.
+  * @param n Size of the range.
+  * @param grain Number of indices in each chunk.
+  * @param body Function to be called on each chunk.
+  */
+template<class Function>
+static void parallelFor(
+  Eigen::Index n,
+  Eigen::Index grain,
+  Function body
+)
+{
+  QList<QPair<Eigen::Index, Eigen::Index>> chunks;
+  for(Eigen::Index begin=0; begin<n; begin+=grain) {
+    chunks.append({begin, std::min(begin+grain, n)});
+  }
+  QtConcurrent::blockingMap(chunks, [&](const QPair<Eigen::Index, Eigen::Index>& chunk) {
+    body(chunk.first, chunk.second);
+  });
+}
 
 
 LpgPlanner::LpgPlanner(
@@ -15,33 +47,134 @@ LpgPlanner::LpgPlanner(
   , router_(router)
   , database_(database)
 {
+  // Nothing to do here.
+}
+
+
+void LpgPlanner::calibrateBudget()
+{
+  // Synthetic problem: a few stations, evenly spaced along a straight road.
+  constexpr int N_STATIONS = 8;
+  constexpr double SPACING_KM = 80.0;
+
+  LpgProblem problem;
+  problem.fuel_efficiency = 10.0;
+  problem.tank_capacity = 50.0;
+  problem.minimum_purchase = 10.0;
+  problem.autonomy_margin = 10.0;
+  problem.initial_fuel = 10.0;
+
+  QList<int> stations(N_STATIONS);
+  QList<double> prices(N_STATIONS);
+  QList<double> detours(N_STATIONS, 0.0);
+  QList<QList<double>> distances(N_STATIONS, QList<double>(N_STATIONS));
+  for(int i=0; i<N_STATIONS; i++) {
+    stations[i] = i;
+    prices[i] = 0.9 + 0.05 * (i % 3);
+    for(int j=0; j<N_STATIONS; j++) {
+      distances[i][j] = SPACING_KM * std::abs(i - j);
+    }
+  }
 
+  // Time the enumeration of all subsets.
+  QElapsedTimer timer;
+  timer.start();
+  findRoutes(problem, stations, prices, detours, distances);
+  budget_.update(1e-9 * timer.nsecsElapsed(), CandidateBudget::subsetCount(N_STATIONS));
+  qDebug() << "Estimated solve time per subset:" << budget_.subsetCost() << "s";
 }
 
 
-void LpgPlanner::exportPath(
-  const QList<double>& latitudes,
-  const QList<double>& longitudes
+bool LpgPlanner::bestStationsNear(
+  double latitude,
+  double longitude,
+  double radius_km,
+  int count,
+  double penalty_per_km,
+  QList<StationIndex::Match>& matches
 )
 {
-  if(latitudes.isEmpty() || longitudes.isEmpty() || latitudes.size() != longitudes.size()) {
-    qDebug() << "ERROR: latitudes and longitudes are not ok";
-    return;
+  matches.clear();
+  if(!refreshStationIndex()) {
+    return false;
   }
 
-  // Compute bounding box.
-  double min_lat = 90.0;
-  double max_lat = -90.0;
-  double min_lon = 180.0;
-  double max_lon = -180.0;
+  // Stations with invalid prices have infinite score, and only show up when
+  // there are not enough valid ones.
+  matches = station_index_.bestNear(latitude, longitude, radius_km, count, penalty_per_km);
+  while(!matches.isEmpty() && !std::isfinite(matches.last().score)) {
+    matches.removeLast();
+  }
+  return true;
+}
 
-  for(unsigned int i=0; i<latitudes.size(); i++) {
-    min_lat = qMin(min_lat, latitudes[i]);
-    max_lat = qMax(max_lat, latitudes[i]);
-    min_lon = qMin(min_lon, longitudes[i]);
-    max_lon = qMax(max_lon, longitudes[i]);
+
+bool LpgPlanner::refreshStationIndex()
+{
+  // Nothing to do if the database has not changed. Without a version, there
+  // is no way to tell, so the stations are read again.
+  qint64 version;
+  const bool has_version = database_->dataVersion(version);
+  if(has_version && version == station_index_version_) {
+    return true;
   }
 
+  DatabaseManager::StationData stations;
+  if(!database_->allStations(
+    DatabaseManager::ID | DatabaseManager::PRICE | DatabaseManager::LATITUDE | DatabaseManager::LONGITUDE,
+    stations
+  )) {
+    return false;
+  }
+  const QList<int>& ids = stations.ids;
+  QList<double>& prices = stations.prices;
+  const QList<double>& latitudes = stations.latitudes;
+  const QList<double>& longitudes = stations.longitudes;
+
+  // Stations with invalid prices are kept in the index, but they can never
+  // be the cheapest ones.
+  for(double& price : prices) {
+    if(price < MIN_PRICE || price > MAX_PRICE) {
+      price = std::numeric_limits<double>::infinity();
+    }
+  }
+
+  // If the stations are the same, only prices need to be updated.
+  if(station_index_.hasStations(ids, latitudes, longitudes)) {
+    int count = 0;
+    for(int i=0; i<ids.size(); i++) {
+      if(prices[i] != station_index_.price(i)) {
+        station_index_.updatePrice(i, prices[i]);
+        count++;
+      }
+    }
+    qDebug() << "Updated" << count << "prices in the station index";
+  }
+  else {
+    station_index_ = StationIndex(ids, prices, latitudes, longitudes);
+    qDebug() << "Built station index with" << station_index_.size() << "stations";
+  }
+
+  station_index_version_ = has_version ? version : -1;
+  return true;
+}
+
+
+void LpgPlanner::exportPath(
+  const PathGeometry& path
+)
+{
+  if(path.isEmpty()) {
+    qDebug() << "ERROR: the path is empty";
+    return;
+  }
+
+  // Bounding box, precomputed by the path itself.
+  const double min_lat = path.bounds().min_latitude;
+  const double max_lat = path.bounds().max_latitude;
+  const double min_lon = path.bounds().min_longitude;
+  const double max_lon = path.bounds().max_longitude;
+
   // Approximate zoom level.
   constexpr double zoom_margin = 2.0;
   int zoom_latitude = static_cast<int>(qFloor(std::log2(zoom_margin * 360.0 / (max_lat - min_lat))));
@@ -51,10 +184,11 @@ void LpgPlanner::exportPath(
 
   // Save path as QVariantList for QML.
   QVariantList path_variant;
-  for(unsigned int i=0; i<latitudes.size(); i++) {
+  path_variant.reserve(path.size());
+  for(Eigen::Index i=0; i<path.size(); i++) {
     QVariantMap map;
-    map["latitude"] = latitudes[i];
-    map["longitude"] = longitudes[i];
+    map["latitude"] = path.latitudes()(i);
+    map["longitude"] = path.longitudes()(i);
     path_variant.append(map);
   }
 
@@ -124,216 +258,340 @@ void LpgPlanner::solve(
 
   // Calculate the path from departure to arrival.
   QList<double> path_latitudes_qlist, path_longitudes_qlist;
-  bool ok = router_->path(
-    {problem.departure_latitude, problem.arrival_latitude},
-    {problem.departure_longitude, problem.arrival_longitude},
-    path_latitudes_qlist,
-    path_longitudes_qlist
-  );
+  if(router_->hasGreatCirclePaths()) {
+    // The router would only sample the great-circle arc at a fixed step: the
+    // points are generated here instead, at the coarsest step that keeps the
+    // chord within the path tolerance from the arc (the sagitta of a chord of
+    // length s is s^2/8R) and the vertices within the narrowest corridor, so
+    // that no simplification is needed afterwards.
+    GreatCirclePath arc(
+      {problem.departure_latitude, problem.arrival_latitude},
+      {problem.departure_longitude, problem.arrival_longitude}
+    );
+    double resolution = problem.min_search_distance;
+    if(problem.path_tolerance > 0.0) {
+      resolution = std::min(
+        resolution,
+        std::sqrt(8.0 * math_utilities::EARTH_RADIUS_KM * problem.path_tolerance)
+      );
+    }
+    const qsizetype pieces = std::max<qsizetype>(
+      1,
+      (qsizetype)std::ceil(arc.length() / std::max(resolution, 1e-3))
+    );
+    path_latitudes_qlist.resize(pieces + 1);
+    path_longitudes_qlist.resize(pieces + 1);
+    for(qsizetype k=0; k<=pieces; k++) {
+      arc.point(0, (double)k / pieces, path_latitudes_qlist[k], path_longitudes_qlist[k]);
+    }
+    qDebug() << "Great-circle path of" << arc.length() << "km sampled with" << path_latitudes_qlist.size() << "points";
+  }
+  else {
+    QList<double> raw_path_latitudes, raw_path_longitudes;
+    bool ok = router_->path(
+      {problem.departure_latitude, problem.arrival_latitude},
+      {problem.departure_longitude, problem.arrival_longitude},
+      raw_path_latitudes,
+      raw_path_longitudes
+    );
 
-  if(!ok) {
-    emit failed(QString("Failed to find path from departure to arrival"));
-    return;
+    if(!ok) {
+      emit failed(QString("Failed to find path from departure to arrival"));
+      return;
+    }
+
+    // Routing services can return tens of thousands of vertices, but we only
+    // need the shape of the path up to some tolerance: simplify it right away,
+    // so that all the following steps work on a much smaller polyline. The raw
+    // path is kept untouched. Stations are measured against the segments of
+    // the simplified path, so that widening the corridor by the tolerance is
+    // enough not to miss any of them; vertices are still used to place
+    // stations along the path, so they should not be farther apart than the
+    // narrowest corridor.
+    std::vector<Eigen::Index> simplified_idx = math_utilities::simplifyPolyline(
+      Eigen::Map<const Eigen::ArrayXd>(raw_path_latitudes.data(), raw_path_latitudes.size()),
+      Eigen::Map<const Eigen::ArrayXd>(raw_path_longitudes.data(), raw_path_longitudes.size()),
+      problem.path_tolerance,
+      problem.min_search_distance
+    );
+    path_latitudes_qlist.resize(simplified_idx.size());
+    path_longitudes_qlist.resize(simplified_idx.size());
+    for(unsigned int i=0; i<simplified_idx.size(); i++) {
+      path_latitudes_qlist[i] = raw_path_latitudes[simplified_idx[i]];
+      path_longitudes_qlist[i] = raw_path_longitudes[simplified_idx[i]];
+    }
+    qDebug() << "Simplified path from" << raw_path_latitudes.size() << "to" << path_latitudes_qlist.size() << "points";
   }
 
+  // Gather the geometry of the path: coordinates, arclength and bounding
+  // boxes are calculated once and shared by all the following steps.
+  PathGeometry path(path_latitudes_qlist, path_longitudes_qlist);
+  const Eigen::ArrayXd& path_arclength = path.arclength();
+
   // Show the path on a map.
-  exportPath(path_latitudes_qlist, path_longitudes_qlist);
-
-  // qDebug() << "WARNING: LOADING PATH FROM TEXT FOR DEBUGGING PURPOSES!";
-  // Eigen::ArrayXXd path_coordinates = math_utilities::loadArray("C:/Users/franc/AppData/Roaming/lpg_planner/sample-path.txt");
-  // auto path_latitudes = path_coordinates.col(0);
-  // auto path_longitudes = path_coordinates.col(1);
-  Eigen::Map<const Eigen::VectorXd> path_latitudes_map(path_latitudes_qlist.data(), path_latitudes_qlist.size());
-  Eigen::Map<const Eigen::VectorXd> path_longitudes_map(path_longitudes_qlist.data(), path_longitudes_qlist.size());
-  auto path_latitudes = path_latitudes_map.array();
-  auto path_longitudes = path_longitudes_map.array();
-
-  // Find stations that are in a selected area of interest.
-  double min_latitude = path_latitudes.minCoeff();
-  double max_latitude = path_latitudes.maxCoeff();
-  double min_longitude = path_longitudes.minCoeff();
-  double max_longitude = path_longitudes.maxCoeff();
-  double latitude_margin = math_utilities::latitude_variation(problem.search_distance);
-  double longitude_margin = math_utilities::longitude_variation(
-    problem.search_distance,
-    std::max(std::abs(min_latitude), std::abs(max_latitude))
-  );
-
-  // Create a filter to select only a subset of all possible stations.
-  DatabaseManager::Filter db_filter;
-  db_filter.setGPSRange(
-    min_latitude - 2*latitude_margin,
-    max_latitude + 2*latitude_margin,
-    min_longitude - 2*longitude_margin,
-    max_longitude + 2*longitude_margin
-  );
-  db_filter.setPriceRange(0.1, 2.0); // TODO: Make these a parameter!
-  // TODO: select only stations that have a recent update.
-
-  QList<int> stations_ids;
-  QList<double> stations_prices, stations_latitudes, stations_longitudes;
-  ok = database_->findStations(
-    db_filter,
-    &stations_ids,
-    &stations_prices,
-    &stations_latitudes,
-    &stations_longitudes,
-    nullptr,
-    nullptr
-  );
+  exportPath(path);
 
-  if(!ok) {
+  // Stations are looked up in the station index, which holds all the stations
+  // in the database; stations with invalid prices have infinite price there.
+  if(!refreshStationIndex()) {
     emit failed("Failed to access database");
     return;
   }
 
-  if(stations_ids.size() == 0) {
+  if(station_index_.isEmpty()) {
     emit failed("Could not find any station between the departure and the arrival");
     return;
   }
 
-  qDebug() << "Selected " << stations_ids.size() << "stations 'near' path";
-
-  qDebug() << "Calculating path distances";
-  auto path_distances = math_utilities::haversineDistance(
-    path_latitudes.head(path_latitudes.rows()-1),
-    path_longitudes.head(path_longitudes.rows()-1),
-    path_latitudes.tail(path_latitudes.rows()-1),
-    path_longitudes.tail(path_longitudes.rows()-1)
-  );
+  // If a target solve time is given, choose the segment length so that the
+  // number of candidates (and thus the solve time) stays within budget. The
+  // budget is calibrated the first time it is needed, unless a previous plan
+  // has already measured the solve time.
+  if(problem.target_solve_time > 0) {
+    if(!budget_.isCalibrated()) {
+      calibrateBudget();
+    }
+    problem.segment_length = budget_.segmentLength(
+      problem.target_solve_time,
+      path.length(),
+      problem.window_overlap,
+      problem.stations_per_window,
+      problem.search_distance
+    );
+    qDebug() << "Using segments of length" << problem.segment_length << "km to solve within" << problem.target_solve_time << "s";
+  }
 
-  qDebug() << "Calculating arclengths";
-  Eigen::ArrayXd path_arclength(path_distances.size() + 1);
-  path_arclength(0) = 0;
-  for(unsigned int i=1; i<path_arclength.size(); i++) {
-    path_arclength(i) = path_arclength(i-1) + path_distances(i-1);
+  qDebug() << "Divinding path into segments";
+  // Each window spans 'window_overlap' consecutive cells, and consecutive
+  // windows are shifted by one cell. Cuts are placed at regular arclength
+  // intervals, and expressed as indices of points in the path.
+  const unsigned int W = problem.window_overlap;
+  const double path_length = path.length();
+  const unsigned int N_CUTS = std::max(W, static_cast<unsigned int>(std::ceil(W*path_length / problem.segment_length)));
+  Eigen::ArrayXi segments(N_CUTS+1);
+  for(unsigned int c=0; c<=N_CUTS; c++) {
+    segments(c) = std::distance(
+      path_arclength.data(),
+      std::lower_bound(
+        path_arclength.data(),
+        path_arclength.data() + path_arclength.size(),
+        path_length * c / N_CUTS
+      )
+    );
   }
-  std::cout << "Distances: " << path_distances.head(10).transpose() << std::endl;
-  std::cout << "Arclength: " << path_arclength.head(10).transpose() << std::endl;
+  qDebug() << "Cuts:" << N_CUTS << "; Segments:" << QList<int>(segments.data(), segments.data() + segments.size());
+
+  qDebug() << "Looking for candidate stations in a corridor adapted to their density";
+  // In dense regions a narrow corridor is enough, while in sparse ones we
+  // need to look farther away from the path. Each cell is searched on its own,
+  // with a corridor of width 'min_search_distance' which is doubled until the
+  // cell contains 'min_stations_per_window' stations or the width reaches
+  // 'search_distance': the index is only queried with the box of the current
+  // width, so dense cells never look at the stations of the wider ones.
+  //
+  // Stations are measured against the segments of the path. A station belongs
+  // to the cell that contains the closest end of its closest segment (cell c
+  // covers the points in (segments(c), segments(c+1)], the first one also
+  // includes point 0), so that its closest point lies on the segments from
+  // point segments(c) to point segments(c+1)+1: the bounding box of these
+  // points, enlarged by the width of the corridor, contains all the stations
+  // of the cell. Stations can be up to 'path_tolerance' farther from the
+  // simplified path than from the real one, so the width is increased
+  // accordingly. Cells are independent, and are searched in parallel.
+  //
+  // Boxes are built from the fixed-point coordinates of the path, and the
+  // index compares them with those of the stations as integers. Margins are
+  // rounded up by one unit to cover the rounding of the path (stations from
+  // the database are stored exactly): the box never loses a station within
+  // the corridor, and admits at most 2e-6 degrees (about 22 cm) more, which
+  // are then rejected by the distance from the path, calculated in double.
+  std::vector<std::vector<int>> cell_stations(N_CUTS);
+  std::vector<std::vector<int>> cell_closest_points(N_CUTS);
+  std::vector<std::vector<double>> cell_distances(N_CUTS);
+  parallelFor(N_CUTS, 1, [&](Eigen::Index begin, Eigen::Index end) {
+    for(Eigen::Index c=begin; c<end; c++) {
+      const Eigen::Index first_point = segments(c);
+      const Eigen::Index last_point = std::min<Eigen::Index>(segments(c+1) + 1, path.size() - 1);
+      StationIndex::FixedBoundingBox cell_box;
+      for(Eigen::Index k=first_point; k<=last_point; k++) {
+        cell_box.extend(path.fixedLatitudes()(k), path.fixedLongitudes()(k));
+      }
+      const double cell_max_latitude = math_utilities::fromFixedPoint(
+        std::max(std::abs(cell_box.min_latitude), std::abs(cell_box.max_latitude))
+      );
 
-  qDebug() << "Looking for candidate stations (within 'search_distance' from the path)";
-  Eigen::ArrayXi stations_on_path(stations_ids.size());
-  Eigen::Index count = 0;
-  for(unsigned int i=0; i<stations_ids.size(); i++) {
-    if(stations_prices[i] < 0.4) {
-      qDebug() << "FOUND BAD STATION";
-      continue;
+      // Widen the corridor until there are enough stations.
+      double width = problem.min_search_distance;
+      while(true) {
+        cell_stations[c].clear();
+        cell_closest_points[c].clear();
+        cell_distances[c].clear();
+
+        const double corridor_width = width + problem.path_tolerance;
+        const std::int32_t latitude_margin = math_utilities::toFixedPointMargin(
+          math_utilities::latitude_variation(corridor_width)
+        );
+        const std::int32_t longitude_margin = math_utilities::toFixedPointMargin(
+          math_utilities::longitude_variation(corridor_width, cell_max_latitude)
+        );
+        StationIndex::FixedBoundingBox box;
+        box.min_latitude = cell_box.min_latitude - latitude_margin;
+        box.max_latitude = cell_box.max_latitude + latitude_margin;
+        box.min_longitude = cell_box.min_longitude - longitude_margin;
+        box.max_longitude = cell_box.max_longitude + longitude_margin;
+
+        station_index_.forEachIn(box, [&](Eigen::Index i) {
+          if(!std::isfinite(station_index_.price(i))) {
+            return;
+          }
+          Eigen::Index segment;
+          double fraction;
+          const double distance = path.distanceTo(
+            station_index_.latitude(i),
+            station_index_.longitude(i),
+            segment,
+            fraction
+          );
+          const Eigen::Index closest_point = fraction > 0.5 ? segment + 1 : segment;
+          if(distance > corridor_width
+            || (c > 0 && closest_point <= segments(c))
+            || (c < N_CUTS-1 && closest_point > segments(c+1))) {
+            return;
+          }
+          cell_stations[c].push_back(i);
+          cell_closest_points[c].push_back(closest_point);
+          cell_distances[c].push_back(distance);
+        });
+
+        if(width >= problem.search_distance || static_cast<int>(cell_stations[c].size()) >= problem.min_stations_per_window) {
+          break;
+        }
+        width = std::min(2*width, problem.search_distance);
+      }
     }
+  });
 
-    auto dlat = (path_latitudes - stations_latitudes[i]).abs();
-    auto dlon = (path_longitudes - stations_longitudes[i]).abs();
-    if(((dlat < latitude_margin) && (dlon < longitude_margin)).any()) {
-      stations_on_path(count) = i;
+  // Gather the candidates of all cells. The stations are identified by their
+  // index in station_index_.
+  Eigen::Index count = 0;
+  for(const std::vector<int>& stations_in_cell : cell_stations) {
+    count += stations_in_cell.size();
+  }
+  Eigen::ArrayXi stations_on_path(count);
+  Eigen::ArrayXi closest_point_on_path(count);
+  Eigen::ArrayXd distance_from_path(count);
+  count = 0;
+  for(unsigned int c=0; c<N_CUTS; c++) {
+    for(unsigned int k=0; k<cell_stations[c].size(); k++) {
+      stations_on_path(count) = cell_stations[c][k];
+      closest_point_on_path(count) = cell_closest_points[c][k];
+      distance_from_path(count) = cell_distances[c][k];
       count++;
     }
   }
-  stations_on_path.conservativeResize(count);
-  qDebug() << "Found" << stations_on_path.size() << "candidates";
+  qDebug() << "Found" << count << "candidates inside the adaptive corridor";
 
   if(stations_on_path.size() == 0) {
     emit failed("Could not find any station along the path");
     return;
   }
 
-  qDebug() << "Calculating closest point on path";
-  Eigen::ArrayXi closest_point_on_path(stations_on_path.size());
+  qDebug() << "Sorting stations along path";
+  // Closest points are indices of points in the path, so that counting sort
+  // can be used.
+  auto sorted_idx = math_utilities::countingArgsort(closest_point_on_path, path.size()-1);
+  math_utilities::permute(sorted_idx, closest_point_on_path, stations_on_path, distance_from_path);
+
+  qDebug() << "Copying prices and coordinates for candidate stations";
+  Eigen::ArrayXd prices_on_path(stations_on_path.size());
   for(unsigned int i=0; i<stations_on_path.size(); i++) {
-    math_utilities::haversineDistance(
-      path_latitudes,
-      path_longitudes,
-      stations_latitudes[stations_on_path[i]],
-      stations_longitudes[stations_on_path[i]]
-    ).minCoeff(&closest_point_on_path(i));
+    prices_on_path(i) = station_index_.price(stations_on_path(i));
   }
 
-  qDebug() << "Sorting stations along path";
-  auto sorted_idx = math_utilities::argsort(closest_point_on_path);
-  math_utilities::sortBy(closest_point_on_path, sorted_idx);
-  math_utilities::sortBy(stations_on_path, sorted_idx);
+  if(problem.skyline_window > 0) {
+    qDebug() << "Removing candidates that are dominated by their neighbours";
+    // A station is of no interest if, nearby along the path, there is another
+    // one that is both cheaper and closer to the path.
+    Eigen::ArrayXd arclength_on_path(stations_on_path.size());
+    for(unsigned int i=0; i<stations_on_path.size(); i++) {
+      arclength_on_path(i) = path_arclength(closest_point_on_path(i));
+    }
+    std::vector<bool> not_dominated = math_utilities::skyline(
+      arclength_on_path,
+      prices_on_path,
+      distance_from_path,
+      problem.skyline_window
+    );
 
-  qDebug() << "Divinding path into segments";
-  const unsigned int N_CUTS = static_cast<unsigned int>(std::ceil(2*path_arclength(path_arclength.size()-1) / problem.segment_length));
-  Eigen::ArrayXi segments = (Eigen::ArrayXd::LinSpaced(N_CUTS+1, 0, N_CUTS) * (static_cast<double>(path_arclength.size()) / N_CUTS)).round().cast<int>();
-  std::cout << "Cuts: " << N_CUTS << "; Segments: " << segments.transpose() << std::endl;
+    // Remove dominated candidates, preserving the ordering.
+    count = 0;
+    for(unsigned int i=0; i<not_dominated.size(); i++) {
+      if(not_dominated[i]) {
+        stations_on_path(count) = stations_on_path(i);
+        closest_point_on_path(count) = closest_point_on_path(i);
+        distance_from_path(count) = distance_from_path(i);
+        prices_on_path(count) = prices_on_path(i);
+        count++;
+      }
+    }
+    stations_on_path.conservativeResize(count);
+    closest_point_on_path.conservativeResize(count);
+    distance_from_path.conservativeResize(count);
+    prices_on_path.conservativeResize(count);
+    qDebug() << "Kept" << count << "non-dominated candidates";
+  }
 
-  qDebug() << "Copying prices and coordinates for candidate stations";
-  Eigen::ArrayXd prices_on_path(stations_on_path.size());
+  qDebug() << "Estimating detour costs for candidate stations";
+  // Reaching a station off the route costs fuel too, so the stations are
+  // compared by their effective price instead of the pump price.
+  Eigen::ArrayXd effective_prices_on_path(stations_on_path.size());
   for(unsigned int i=0; i<stations_on_path.size(); i++) {
-    prices_on_path(i) = stations_prices[stations_on_path(i)];
+    effective_prices_on_path(i) = problem.effectivePrice(prices_on_path(i), distance_from_path(i));
   }
 
   qDebug() << "Choosing cheapest stations in each segment";
-  std::vector<int> cheapest_stations;
-  cheapest_stations.reserve(N_CUTS);
-
-  // This is a bit convoluted, but here it is:
-  // The path is being cut into segments, so that we consider portions from
-  // path(a) to path(b) at each iteration. The cuts are made at regular
-  // intervals and gathered as: [s1, s2, s3, s4, s5, ...], but we consider
-  // as extremities the pairs (s1, s3), (s2, s4), (s3, s5), etc.
-  // At the same time, we want to find all elements of closest_point_on_path
-  // that are contained in a segment. As an example, if the cuts are:
-  // [0, 20, 40, 60, 80] and the content of closest_point_on_path is
-  // [2, 12, 21, 38, 50, 67, 75, 79], we want to consider the following
-  // segments:
-  //   1. From 0 to 40; the points are [2, 12, 21, 38].
-  //   2. From 20 to 60; the points are [21, 38, 50].
-  //   3. From 40 to 80; the points are [50, 67, 75, 79].
-  // To achieve the partition above, the following variables are used:
-  // - i0 tells where the interval begins, inside closest_point_on_path. In the
-  //     example, it would be 0, 2 & 4 (the indices of 2, 21 and 50
-  //     respectively).
-  // - i1 is just used as a 'memory variable'. At the end of an iteration, its
-  //     value is copied into i0 and it gets the value of i2.
-  // - i2 tells where the interval stops, inside closest_point_on_path. In the
-  //     example, it would be 4, 5 & 8 (one plus the indices of 38, 50 and 79).
-  // Using these, it is a bit easier and more efficient to perform the loop:
-  // at each iteration, we can copy copy i1 into i0 and i2 into i1, and then
-  // find the new value of i2.
-  unsigned int i0 = 0;
-  unsigned int i1 = 0;
-  unsigned int i2 = std::distance(
-    closest_point_on_path.data(),
-    std::upper_bound(
-      closest_point_on_path.data(),
-      closest_point_on_path.data() + closest_point_on_path.size(),
-      segments(1)
-    )
-  );
-
-  for(unsigned int s=2; s<segments.size() && i2<closest_point_on_path.size(); s++) {
-    i0 = i1;
-    i1 = i2;
-
-    if(s == segments.size()-1) {
-      i2 = closest_point_on_path.size();
-    }
-    else {
-      i2 = std::distance(
-        closest_point_on_path.data(),
-        std::upper_bound(
-          closest_point_on_path.data() + i1,
-          closest_point_on_path.data() + closest_point_on_path.size(),
-          segments(s)
-        )
-      );
+  // Stations are ranked by effective price and, in case of ties, by their
+  // distance from the path. The window stores indices of candidates (sorted
+  // along the path).
+  auto cheaper = [&](Eigen::Index a, Eigen::Index b) {
+    if(effective_prices_on_path(a) != effective_prices_on_path(b))
+      return effective_prices_on_path(a) < effective_prices_on_path(b);
+    return distance_from_path(a) < distance_from_path(b);
+  };
+  KBestWindow<Eigen::Index, decltype(cheaper)> window(problem.stations_per_window, cheaper);
+
+  // Since candidates are sorted along the path, window extremities can be
+  // found with two monotonic pointers: window s contains the candidates whose
+  // closest point lies in (segments(s-W), segments(s)]. The first and last
+  // windows are extended to include the extremities of the path.
+  std::vector<bool> selected(stations_on_path.size(), false);
+  Eigen::Index pushed = 0;
+  Eigen::Index popped = 0;
+  for(unsigned int s=W; s<segments.size() && pushed<closest_point_on_path.size(); s++) {
+    // Add candidates that entered the window.
+    while(pushed < closest_point_on_path.size() && (s == segments.size()-1 || closest_point_on_path(pushed) <= segments(s))) {
+      window.push(pushed++);
     }
 
-    if(i0 == i2) {
-      // Empty segment: skip it!
-      continue;
+    // Remove candidates that left the window.
+    while(s > W && popped < pushed && closest_point_on_path(popped) <= segments(s-W)) {
+      window.pop();
+      popped++;
     }
 
-    // Find the cheapest of the stations in this segment.
-    // TODO: it would be nice to handle ties byu selecting the closest one to the path.
-    // std::cout << "Looking for cheapest station in set: " << prices_on_path.segment(i0, i2-i0).transpose() << std::endl;
-    Eigen::Index i_cheapest;
-    prices_on_path.segment(i0, i2-i0).minCoeff(&i_cheapest);
-    i_cheapest += i0;
+    // Mark the best stations in this window - empty windows are skipped.
+    for(Eigen::Index i : window.best()) {
+      selected[i] = true;
+    }
+  }
 
-    // Add this station if it was not in the list already.
-    if (cheapest_stations.size() == 0 || cheapest_stations.back() != stations_on_path[i_cheapest]) {
-      cheapest_stations.push_back(stations_on_path[i_cheapest]);
+  // Gather selected stations, preserving their order along the path.
+  std::vector<int> cheapest_stations;
+  std::vector<double> cheapest_detours;
+  for(unsigned int i=0; i<selected.size(); i++) {
+    if(selected[i]) {
+      cheapest_stations.push_back(stations_on_path[i]);
+      cheapest_detours.push_back(distance_from_path[i]);
     }
   }
 
@@ -341,101 +599,81 @@ void LpgPlanner::solve(
 
   Eigen::ArrayXi stations(cheapest_stations.size());
   Eigen::ArrayXd prices(cheapest_stations.size());
+  Eigen::ArrayXd detours(cheapest_stations.size());
   Eigen::ArrayXd latitudes(cheapest_stations.size());
   Eigen::ArrayXd longitudes(cheapest_stations.size());
 
   for(unsigned int i=0; i<cheapest_stations.size(); i++) {
     const auto& station_idx = cheapest_stations[i];
-    stations[i] = stations_ids[station_idx];
-    prices[i] = stations_prices[station_idx];
-    latitudes[i] = stations_latitudes[station_idx];
-    longitudes[i] = stations_longitudes[station_idx];
+    stations[i] = station_index_.id(station_idx);
+    prices[i] = station_index_.price(station_idx);
+    detours[i] = cheapest_detours[i];
+    latitudes[i] = station_index_.latitude(station_idx);
+    longitudes[i] = station_index_.longitude(station_idx);
   }
 
+  // Distance of a station in the index from a given point.
+  auto detour_from = [&](Eigen::Index i, double latitude, double longitude) {
+    return math_utilities::distance_policy::Haversine::distance(
+      station_index_.latitude(i),
+      station_index_.longitude(i),
+      latitude,
+      longitude
+    );
+  };
+
+  // Pick the station with the lowest effective price within 2*search_distance
+  // from the given point; the detour is measured from the point itself.
+  auto cheapest_near = [&](double latitude, double longitude) {
+    const double box_latitude_margin = math_utilities::latitude_variation(2*problem.search_distance);
+    const double box_longitude_margin = math_utilities::longitude_variation(2*problem.search_distance, latitude);
+    StationIndex::BoundingBox box;
+    box.min_latitude = latitude - box_latitude_margin;
+    box.max_latitude = latitude + box_latitude_margin;
+    box.min_longitude = longitude - box_longitude_margin;
+    box.max_longitude = longitude + box_longitude_margin;
+    return station_index_.cheapest(box, [&](Eigen::Index i) {
+      return problem.effectivePrice(station_index_.price(i), detour_from(i, latitude, longitude));
+    });
+  };
+
   // Add departure station.
-  double departure_latitude_margin = math_utilities::latitude_variation(2*problem.search_distance);
-  double departure_longitude_margin = math_utilities::longitude_variation(2*problem.search_distance, problem.departure_latitude);
-
-  // Create a filter to select only a subset of all possible stations.
-  db_filter.setGPSRange(
-    problem.departure_latitude - departure_latitude_margin,
-    problem.departure_latitude + departure_latitude_margin,
-    problem.departure_longitude - departure_longitude_margin,
-    problem.departure_longitude + departure_longitude_margin
-  );
-
-  QList<int> departure_stations_ids;
-  QList<double> departure_stations_prices, departure_stations_latitudes, departure_stations_longitudes;
-  ok = database_->findStations(
-    db_filter,
-    &departure_stations_ids,
-    &departure_stations_prices,
-    &departure_stations_latitudes,
-    &departure_stations_longitudes,
-    nullptr,
-    nullptr
-  );
-
-  if(ok && departure_stations_ids.size() > 0) {
-    int idx;
-    Eigen::Map<const Eigen::VectorXd>(departure_stations_prices.data(), departure_stations_prices.size()).minCoeff(&idx);
-    if(departure_stations_ids[idx] != stations[0]) {
-      qDebug() << "Adding departure station ID =" << departure_stations_ids[idx];
-      stations.conservativeResize(stations.size()+1);
-      prices.conservativeResize(prices.size()+1);
-      latitudes.conservativeResize(latitudes.size()+1);
-      longitudes.conservativeResize(longitudes.size()+1);
-      for(int i=stations.size()-1; i>0; i--) {
-        stations(i) = stations(i-1);
-        prices(i) = prices(i-1);
-        latitudes(i) = latitudes(i-1);
-        longitudes(i) = longitudes(i-1);
-      }
-      stations(0) = departure_stations_ids[idx];
-      prices(0) = departure_stations_prices[idx];
-      latitudes(0) = departure_stations_latitudes[idx];
-      longitudes(0) = departure_stations_longitudes[idx];
+  Eigen::Index departure = cheapest_near(problem.departure_latitude, problem.departure_longitude);
+  if(departure >= 0 && station_index_.id(departure) != stations[0]) {
+    qDebug() << "Adding departure station ID =" << station_index_.id(departure);
+    stations.conservativeResize(stations.size()+1);
+    prices.conservativeResize(prices.size()+1);
+    detours.conservativeResize(detours.size()+1);
+    latitudes.conservativeResize(latitudes.size()+1);
+    longitudes.conservativeResize(longitudes.size()+1);
+    for(int i=stations.size()-1; i>0; i--) {
+      stations(i) = stations(i-1);
+      prices(i) = prices(i-1);
+      detours(i) = detours(i-1);
+      latitudes(i) = latitudes(i-1);
+      longitudes(i) = longitudes(i-1);
     }
+    stations(0) = station_index_.id(departure);
+    prices(0) = station_index_.price(departure);
+    detours(0) = detour_from(departure, problem.departure_latitude, problem.departure_longitude);
+    latitudes(0) = station_index_.latitude(departure);
+    longitudes(0) = station_index_.longitude(departure);
   }
 
   // Add arrival station.
-  double arrival_latitude_margin = math_utilities::latitude_variation(2*problem.search_distance);
-  double arrival_longitude_margin = math_utilities::longitude_variation(2*problem.search_distance, problem.arrival_latitude);
-
-  // Create a filter to select only a subset of all possible stations.
-  db_filter.setGPSRange(
-    problem.arrival_latitude - arrival_latitude_margin,
-    problem.arrival_latitude + arrival_latitude_margin,
-    problem.arrival_longitude - arrival_longitude_margin,
-    problem.arrival_longitude + arrival_longitude_margin
-  );
-
-  QList<int> arrival_stations_ids;
-  QList<double> arrival_stations_prices, arrival_stations_latitudes, arrival_stations_longitudes;
-  ok = database_->findStations(
-    db_filter,
-    &arrival_stations_ids,
-    &arrival_stations_prices,
-    &arrival_stations_latitudes,
-    &arrival_stations_longitudes,
-    nullptr,
-    nullptr
-  );
-
-  if(ok && arrival_stations_ids.size() > 0) {
-    int idx;
-    Eigen::Map<const Eigen::VectorXd>(arrival_stations_prices.data(), arrival_stations_prices.size()).minCoeff(&idx);
-    if(arrival_stations_ids[idx] != stations[stations.size()-1]) {
-      qDebug() << "Adding arrival station ID =" << arrival_stations_ids[idx];
-      stations.conservativeResize(stations.size()+1);
-      prices.conservativeResize(prices.size()+1);
-      latitudes.conservativeResize(latitudes.size()+1);
-      longitudes.conservativeResize(longitudes.size()+1);
-      stations(stations.size()-1) = arrival_stations_ids[idx];
-      prices(prices.size()-1) = arrival_stations_prices[idx];
-      latitudes(latitudes.size()-1) = arrival_stations_latitudes[idx];
-      longitudes(longitudes.size()-1) = arrival_stations_longitudes[idx];
-    }
+  Eigen::Index arrival = cheapest_near(problem.arrival_latitude, problem.arrival_longitude);
+  if(arrival >= 0 && station_index_.id(arrival) != stations[stations.size()-1]) {
+    qDebug() << "Adding arrival station ID =" << station_index_.id(arrival);
+    stations.conservativeResize(stations.size()+1);
+    prices.conservativeResize(prices.size()+1);
+    detours.conservativeResize(detours.size()+1);
+    latitudes.conservativeResize(latitudes.size()+1);
+    longitudes.conservativeResize(longitudes.size()+1);
+    stations(stations.size()-1) = station_index_.id(arrival);
+    prices(prices.size()-1) = station_index_.price(arrival);
+    detours(detours.size()-1) = detour_from(arrival, problem.arrival_latitude, problem.arrival_longitude);
+    latitudes(latitudes.size()-1) = station_index_.latitude(arrival);
+    longitudes(longitudes.size()-1) = station_index_.longitude(arrival);
   }
 
   // Show the stations on map.
@@ -452,6 +690,18 @@ void LpgPlanner::solve(
   std::cout << "Latitudes: " << latitudes.transpose() << std::endl;
   std::cout << "Longitudes: " << longitudes.transpose() << std::endl;
 
+  // Departure and arrival must be different stations, and all subsets of the
+  // candidates must be enumerable (this also avoids requesting a distance
+  // matrix that would not be used).
+  if(stations.size() < 2) {
+    emit failed("Could not find enough stations between the departure and the arrival");
+    return;
+  }
+  if(stations.size() > CandidateBudget::MAX_CANDIDATES) {
+    emit failed(QString("Too many candidate stations (%1, at most %2 are allowed): try longer segments or a target solve time").arg(stations.size()).arg(CandidateBudget::MAX_CANDIDATES));
+    return;
+  }
+
   // Request the distance matrix for the given stations.
   QList<int> stations_as_list(stations.size());
   Eigen::Map<Eigen::VectorXi>(stations_as_list.data(), stations.size()) = stations;
@@ -463,46 +713,16 @@ void LpgPlanner::solve(
   }
 
   // Time to solve the optimization.
-  // Vector that will store all results.
-  QList<LpgRoute> routes;
-
-  // Result variables.
-  double total_cost;
-  QList<double> fuel, tank_level;
-
-  // Convert the prices into a QList.
+  // Convert the prices and detours into a QList.
   QList<double> prices_list(prices.data(), prices.data()+prices.size());
+  QList<double> detours_list(detours.data(), detours.data()+detours.size());
 
-  // Maximum number of combinations: 2**(N-2), where N is the number of
-  // waypoints. We use N-2 because the first and last waypoints are fixed.
-  const unsigned int max_combinations = 1 << (prices.size()-2);
-
-  // Scan all combinations from 000...000 to 111...111 (in binary).
-  for(unsigned int combination=0; combination<max_combinations; combination++) {
-    // The first stop is always the first waypoint.
-    QList<int> stops;
-    stops.push_back(0);
-
-    // Isolate the single bits from the current binary string, and add a stop
-    // for every '1' that is found.
-    for(unsigned int c_counter=combination, k=1; c_counter>0; c_counter>>=1, k++) {
-      if(c_counter % 2 > 0)
-        stops.push_back(k);
-    }
-
-    // The last stop is always the last waypoint.
-    stops.push_back(prices.size()-1);
-
-    // Try to solve the optimal fueling problem; if successful, store the
-    // result for later.
-    if(optimalFueling(problem, stops, prices_list, distance_matrix, fuel, tank_level, total_cost)) {
-      QList<int> stops_ids(stops.size());
-      for(unsigned int i=0; i<stops.size(); i++) {
-        stops_ids[i] = stations[stops[i]];
-      }
-      routes.push_back(LpgRoute(total_cost, stops_ids, fuel, tank_level));
-    }
-  }
+  // Solve all subsets, and use the elapsed time to refine the estimate of the
+  // cost of each subset.
+  QElapsedTimer timer;
+  timer.start();
+  QList<LpgRoute> routes = findRoutes(problem, stations_as_list, prices_list, detours_list, distance_matrix);
+  budget_.update(1e-9 * timer.nsecsElapsed(), CandidateBudget::subsetCount(prices.size()));
 
   // If no route has been found, exit.
   if(routes.size() == 0) {
@@ -510,8 +730,9 @@ void LpgPlanner::solve(
     return;
   }
 
-  // Sort solutions by total cost.
-  std::sort(routes.begin(), routes.end(), [&](const auto& a, const auto& b) { return a.cost < b.cost; });
+  // Sort solutions by effective cost, that is the one that accounts for the
+  // detours to reach the stations.
+  std::sort(routes.begin(), routes.end(), [&](const auto& a, const auto& b) { return a.effective_cost < b.effective_cost; });
 
   qDebug() << "Showing stops on map";
   QList<bool> stop_here;
@@ -567,14 +788,71 @@ void LpgPlanner::solve(
 }
 
 
+QList<LpgRoute> LpgPlanner::findRoutes(
+  const LpgProblem& problem,
+  const QList<int>& stations,
+  const QList<double>& prices,
+  const QList<double>& detours,
+  const QList<QList<double>>& distances
+)
+{
+  // Vector that will store all results.
+  QList<LpgRoute> routes;
+
+  // Result variables.
+  double total_cost, effective_cost;
+  QList<double> fuel, tank_level;
+
+  // Maximum number of combinations: 2**(N-2), where N is the number of
+  // waypoints. We use N-2 because the first and last waypoints are fixed.
+  const unsigned long max_combinations = CandidateBudget::subsetCount(prices.size());
+  if(max_combinations == 0) {
+    qDebug() << "Cannot enumerate the subsets of" << prices.size() << "waypoints";
+    return routes;
+  }
+
+  // Scan all combinations from 000...000 to 111...111 (in binary).
+  for(unsigned long combination=0; combination<max_combinations; combination++) {
+    // The first stop is always the first waypoint.
+    QList<int> stops;
+    stops.push_back(0);
+
+    // Isolate the single bits from the current binary string, and add a stop
+    // for every '1' that is found.
+    for(unsigned long c_counter=combination, k=1; c_counter>0; c_counter>>=1, k++) {
+      if(c_counter % 2 > 0)
+        stops.push_back(k);
+    }
+
+    // The last stop is always the last waypoint.
+    stops.push_back(prices.size()-1);
+
+    // Try to solve the optimal fueling problem; if successful, store the
+    // result for later.
+    if(optimalFueling(problem, stops, prices, detours, distances, fuel, tank_level, total_cost, effective_cost)) {
+      QList<int> stops_ids(stops.size());
+      for(unsigned int i=0; i<stops.size(); i++) {
+        stops_ids[i] = stations[stops[i]];
+      }
+      routes.push_back(LpgRoute(total_cost, stops_ids, fuel, tank_level));
+      routes.back().effective_cost = effective_cost;
+    }
+  }
+
+  return routes;
+}
+
+
 bool LpgPlanner::optimalFueling(
   const LpgProblem& problem,
   const QList<int>& stops,
   const QList<double>& all_prices,
+  const QList<double>& all_detours,
   const QList<QList<double>>& all_distances,
   QList<double>& fuel,
   QList<double>& tank_level,
-  double& total_cost
+  double& total_cost,
+  double& effective_cost
 )
 {
   // Obtain n, that is the index of the last stop, and
@@ -585,12 +863,14 @@ bool LpgPlanner::optimalFueling(
     return false;
   }
 
-  // Setup vector of objective coefficients.
+  // Setup vector of objective coefficients: fuel is paid at the effective
+  // price, so that stations far from the route are penalized.
   Eigen::VectorXd prices(n+1);
   for(unsigned int i=0; i<n+1; i++)
     prices(i) = all_prices[stops[i]];
   Eigen::VectorXd f(2*n+1);
-  f.topRows(n+1) = prices;
+  for(unsigned int i=0; i<n+1; i++)
+    f(i) = problem.effectivePrice(prices(i), all_detours[stops[i]]);
   f.bottomRows(n).setZero();
 
   // Setup equality constraints matrix.
@@ -637,6 +917,7 @@ bool LpgPlanner::optimalFueling(
   tank_level.resize(n+1);
   tank_level[0] = problem.initial_fuel;
   Eigen::VectorXd::Map(tank_level.data()+1, n) = x.bottomRows(n);
-  total_cost = f.dot(x);
+  effective_cost = f.dot(x);
+  total_cost = prices.dot(x.topRows(n+1));
   return true;
 }
@@ -1,10 +1,13 @@
 #ifndef LPG_PLANNER_HPP
 #define LPG_PLANNER_HPP
 
+#include "candidate_budget.hpp"
 #include "database_manager.hpp"
 #include "lpg_problem.hpp"
 #include "lpg_route.hpp"
+#include "path_geometry.hpp"
 #include "router_service.hpp"
+#include "station_index.hpp"
 
 #include <QList>
 #include <QObject>
@@ -28,20 +31,70 @@ public:
     QObject *parent = nullptr
   );
 
+  /// Find the best-value stations near a location.
+  /** Stations are ranked by price plus a penalty proportional to their
+    * distance from the location, using the in-memory station index (which is
+    * refreshed if the database has changed).
+    * @see StationIndex::bestNear()
+    * @param latitude GPS latitude of the location.
+    * @param longitude GPS longitude of the location.
+    * @param radius_km Stations farther than this from the location are
+    *   ignored.
+    * @param count Maximum number of stations to be returned.
+    * @param penalty_per_km Penalty added to the price for each km of distance.
+    * @param[out] matches The best stations, sorted from the best to the
+    *   worst. Stations whose price is not in [MIN_PRICE, MAX_PRICE] are not
+    *   considered.
+    * @return false if the database could not be accessed, true otherwise.
+    */
+  bool bestStationsNear(
+    double latitude,
+    double longitude,
+    double radius_km,
+    int count,
+    double penalty_per_km,
+    QList<StationIndex::Match>& matches
+  );
+
 private:
   RouterService* router_ = nullptr; ///< Used to get driving paths and distances.
   DatabaseManager* database_ = nullptr; ///< Used to access the database.
+  CandidateBudget budget_; ///< Used to limit the number of candidate stations.
 
-  /// Send the given list of GPS waypoints to the Map.
+  /// Stations with prices outside [MIN_PRICE, MAX_PRICE] are ignored.
+  /** Prices below 0.4 are known to be bogus entries of the database.
+    */
+  static constexpr double MIN_PRICE = 0.4;
+  static constexpr double MAX_PRICE = 2.0;
+
+  StationIndex station_index_; ///< Spatial index of all stations.
+  qint64 station_index_version_ = -1; ///< Database version the index refers to.
+
+  /// Make sure that the station index is up to date with the database.
+  /** The index is built the first time this is called. Afterwards, it is
+    * updated only if the database has changed: if only prices have changed,
+    * they are updated in place, otherwise the index is built again. If the
+    * database has no version (see DatabaseManager::dataVersion()), the
+    * stations are read each time.
+    * @return false if the database could not be accessed, true otherwise.
+    */
+  bool refreshStationIndex();
+
+  /// Measure how long it takes to solve a subset of stations.
+  /** Runs a small benchmark on a synthetic problem and uses the result to
+    * initialize the estimate stored in budget_. This is done by solve(), the
+    * first time the budget is needed, so that creating a planner is cheap.
+    */
+  void calibrateBudget();
+
+  /// Send the given path to the Map.
   /** Helper method to send a path to a map widget. The list of points is
     * gathered into a QVariantList and new center and zoom level for the map is
     * calculated to focus on the new path. Finally, the pathUpdated() signal is
     * emitted to update the map.
-    * @param latitudes List of GPS latidudes of the waypoints in the path.
-    * @param longitudes List of GPS latitudes of the waypoints in the path. It
-    *   must have the same size as latitudes.
+    * @param path The path to be shown.
     */
-  void exportPath(const QList<double>& latitudes, const QList<double>& longitudes);
+  void exportPath(const PathGeometry& path);
 
   /// Show a set of LPG stations in the map.
   /** This overload will assume that we need to stop at each station.
@@ -65,6 +118,8 @@ private:
     * @param all_prices List of all fuel prices. For the current problem, only
     *   the prices all_prices[stops[0]], all_prices[stops[1]], etc. will be
     *   used.
+    * @param all_detours List of the distances of all stations from the route,
+    *   used to rank them by effective price (see LpgProblem::effectivePrice).
     * @param all_distances Distance matrix for all stops. Only a subset of
     *   the matrix will be used for the current problem, more precisely those
     *   in the form all_distances[stops[i], stops[j]] (where j>i).
@@ -73,8 +128,10 @@ private:
     * @param[out] tank_level If the problem is feasible, this list will contain
     *   the amount of fuel in the tank when arriving at each station, right
     *   before pumping.
-    * @param[out] total_cost Optimal objective function value, i.e., total cost
-    *   of the fuel along the roadtrip - if the problem is feasible.
+    * @param[out] total_cost Total cost of the fuel along the roadtrip, at the
+    *   pump prices - if the problem is feasible.
+    * @param[out] effective_cost Optimal objective function value, i.e., total
+    *   cost of the fuel at effective prices - if the problem is feasible.
     * @return Boolean flag telling if the problem is feasible. Note that if
     *   false is returned (infeasible problem) the output parameters should be
     *   ignored.
@@ -83,10 +140,29 @@ private:
     const LpgProblem& problem,
     const QList<int>& stops,
     const QList<double>& all_prices,
+    const QList<double>& all_detours,
     const QList<QList<double>>& all_distances,
     QList<double>& fuel,
     QList<double>& tank_level,
-    double& total_cost
+    double& total_cost,
+    double& effective_cost
+  );
+
+  /// Solve the fueling problem for all subsets of the candidate stations.
+  /** The first and last candidates are part of all subsets.
+    * @param problem Parameters that define the problem.
+    * @param stations IDs of the candidate stations.
+    * @param prices Fuel prices of the candidate stations.
+    * @param detours Distances of the candidate stations from the route.
+    * @param distances Distance matrix for the candidate stations.
+    * @return The list of routes corresponding to the feasible subsets.
+    */
+  static QList<LpgRoute> findRoutes(
+    const LpgProblem& problem,
+    const QList<int>& stations,
+    const QList<double>& prices,
+    const QList<double>& detours,
+    const QList<QList<double>>& distances
   );
 
 public slots:
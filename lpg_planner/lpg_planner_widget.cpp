@@ -123,6 +123,13 @@ void LpgPlannerWidget::requestRoute() {
   problem.initial_fuel = initial_fuel_spinbox_->value();
   problem.segment_length = 150.0; // HARDCODED, FOR NOW
   problem.search_distance = 5.0; // HARDCODED, FOR NOW
+  problem.min_search_distance = 1.0; // HARDCODED, FOR NOW
+  problem.min_stations_per_window = 3; // HARDCODED, FOR NOW
+  problem.path_tolerance = 0.05; // HARDCODED, FOR NOW
+  problem.skyline_window = 10.0; // HARDCODED, FOR NOW
+  problem.stations_per_window = 1; // HARDCODED, FOR NOW
+  problem.window_overlap = 2; // HARDCODED, FOR NOW
+  problem.target_solve_time = 5.0; // HARDCODED, FOR NOW
   emit solve(problem);
 }
 
@@ -143,9 +150,8 @@ void LpgPlannerWidget::showResult(LpgRoute solution) {
     ids[i] = solution.stops[i].id;
   }
 
-  QList<double> prices;
-  QStringList addresses;
-  if(!database_->stationsFromIds(ids, &prices, nullptr, nullptr, nullptr, &addresses)) {
+  DatabaseManager::StationData stations;
+  if(!database_->stationsFromIds(ids, DatabaseManager::PRICE | DatabaseManager::ADDRESS, stations)) {
     QMessageBox::critical(
       this,
       "Unexpected error",
@@ -159,9 +165,9 @@ void LpgPlannerWidget::showResult(LpgRoute solution) {
   for(unsigned int i=0; i<solution.stops.size(); i++) {
     route_details_->setCellWidget(i, 0, new QLabel(QString::number(solution.stops[i].tank_level_before) + "L"));
     route_details_->setCellWidget(i, 1, new QLabel(QString::number(solution.stops[i].fuel) + "L"));
-    route_details_->setCellWidget(i, 2, new QLabel(QString::number(solution.stops[i].fuel * prices[i]) + "€"));
+    route_details_->setCellWidget(i, 2, new QLabel(QString::number(solution.stops[i].fuel * stations.prices[i]) + "€"));
     route_details_->setCellWidget(i, 3, new QLabel(QString::number(solution.stops[i].tank_level_after) + "L"));
-    route_details_->setCellWidget(i, 4, new QLabel(addresses[i]));
+    route_details_->setCellWidget(i, 4, new QLabel(stations.addresses[i]));
   }
 }
 
@@ -16,6 +16,13 @@ struct LpgProblem {
   double initial_fuel = 0.0;
   double segment_length = 0.0;
   double search_distance = 0.0;
+  double min_search_distance = 0.0;
+  int min_stations_per_window = 0;
+  double path_tolerance = 0.0;
+  double skyline_window = 0.0;
+  int stations_per_window = 0;
+  int window_overlap = 0;
+  double target_solve_time = 0.0;
 
   bool isValid(QString& why) const {
     if(fuel_efficiency <= 0.0) {
@@ -53,6 +60,41 @@ struct LpgProblem {
       return false;
     }
 
+    if(min_search_distance <= 0.0 || min_search_distance > search_distance) {
+      why = "Parameter 'min_search_distance' must be positive and not larger than 'search_distance'";
+      return false;
+    }
+
+    if(min_stations_per_window < 0) {
+      why = "Parameter 'min_stations_per_window' must be positive or zero";
+      return false;
+    }
+
+    if(path_tolerance < 0.0) {
+      why = "Parameter 'path_tolerance' must be positive or zero";
+      return false;
+    }
+
+    if(skyline_window < 0.0) {
+      why = "Parameter 'skyline_window' must be positive or zero";
+      return false;
+    }
+
+    if(stations_per_window <= 0) {
+      why = "Parameter 'stations_per_window' must be positive";
+      return false;
+    }
+
+    if(window_overlap <= 0) {
+      why = "Parameter 'window_overlap' must be positive";
+      return false;
+    }
+
+    if(target_solve_time < 0.0) {
+      why = "Parameter 'target_solve_time' must be positive or zero";
+      return false;
+    }
+
     return true;
   }
 
@@ -60,6 +102,15 @@ struct LpgProblem {
     QString s;
     return isValid(s);
   }
+
+  /// Price of fuel at a station, including the cost of reaching it.
+  /** The station is assumed to be @p detour km away from the route, so
+    * reaching it and coming back costs 2*detour/fuel_efficiency liters, paid
+    * at the station price and spread over a full tank.
+    */
+  inline double effectivePrice(double price, double detour) const {
+    return price * (1.0 + 2.0 * detour / (fuel_efficiency * tank_capacity));
+  }
 };
 
 Q_DECLARE_METATYPE(LpgProblem);
@@ -10,6 +10,7 @@
 /// Auxiliary structure containing information about a sequence of stops.
 struct LpgRoute {
   double cost = 0.0; ///< Total cost of the route.
+  double effective_cost = 0.0; ///< Cost of the route, including detours.
   QList<LpgStop> stops; ///< Stops along the route.
 
   /// Default constructor, needed by Qt's metatype system.
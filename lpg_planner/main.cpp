@@ -1,15 +1,101 @@
 #include "main_window.hpp"
+#include "database_manager.hpp"
+#include "lpg_planner.hpp"
 #include "lpg_problem.hpp"
 #include "lpg_route.hpp"
 #include "lpg_stop.hpp"
+#include "router_service.hpp"
 
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QTextStream>
+
+
+// Answer a "best stations near here" query without starting the GUI.
+static int bestStationsNear(
+  double latitude,
+  double longitude,
+  double radius_km,
+  int count,
+  double penalty_per_km
+)
+{
+  QTextStream out(stdout);
+  QTextStream err(stderr);
+
+  QString db_error = DatabaseManager::loadDatabase();
+  if(!db_error.isEmpty()) {
+    err << "An error occurred while loading the database: " << db_error << Qt::endl;
+    return 1;
+  }
+
+  DatabaseManager database;
+  RouterService router(&database);
+  LpgPlanner planner(&router, &database);
+  QList<StationIndex::Match> matches;
+  if(!planner.bestStationsNear(latitude, longitude, radius_km, count, penalty_per_km, matches)) {
+    err << "Failed to access database" << Qt::endl;
+    return 1;
+  }
+
+  // One station per line, from the best to the worst.
+  out << "id\tprice\tdistance_km\tscore\tlatitude\tlongitude" << Qt::endl;
+  for(const auto& match : matches) {
+    out << match.id << "\t" << match.price << "\t" << match.distance << "\t" << match.score << "\t"
+        << match.latitude << "\t" << match.longitude << Qt::endl;
+  }
+  return 0;
+}
 
 
 int main(int argc, char *argv[]) {
   qRegisterMetaType<LpgProblem>();
   qRegisterMetaType<LpgStop>();
   qRegisterMetaType<LpgRoute>();
+
+  // Parse the command line before creating the application, since headless
+  // queries do not need the GUI.
+  QStringList arguments;
+  for(int i=0; i<argc; i++) {
+    arguments.append(QString::fromLocal8Bit(argv[i]));
+  }
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Find optimal LPG stops along a road-trip.");
+  parser.addHelpOption();
+  QCommandLineOption near_option("near", "Print the best-value stations near a location and exit.", "latitude,longitude");
+  QCommandLineOption radius_option("radius", "Search radius for --near, in km.", "km", "20");
+  QCommandLineOption count_option("count", "Number of stations printed by --near.", "count", "5");
+  QCommandLineOption penalty_option("penalty", "Price penalty per km of distance for --near.", "penalty", "0.01");
+  parser.addOptions({near_option, radius_option, count_option, penalty_option});
+  // Unknown options are left to QApplication (e.g., '-platform').
+  bool parsed = parser.parse(arguments);
+
+  if(parser.isSet("help")) {
+    QCoreApplication a(argc, argv);
+    parser.showHelp();
+  }
+
+  if(parser.isSet(near_option)) {
+    QCoreApplication a(argc, argv);
+    if(!parsed) {
+      QTextStream(stderr) << parser.errorText() << Qt::endl;
+      return 1;
+    }
+    QStringList location = parser.value(near_option).split(",");
+    bool ok_latitude = false, ok_longitude = false, ok_radius, ok_count, ok_penalty;
+    double latitude = location.size() == 2 ? location[0].toDouble(&ok_latitude) : 0.0;
+    double longitude = location.size() == 2 ? location[1].toDouble(&ok_longitude) : 0.0;
+    double radius = parser.value(radius_option).toDouble(&ok_radius);
+    int count = parser.value(count_option).toInt(&ok_count);
+    double penalty = parser.value(penalty_option).toDouble(&ok_penalty);
+    if(!ok_latitude || !ok_longitude || !ok_radius || !ok_count || !ok_penalty || radius <= 0 || count <= 0 || penalty < 0) {
+      QTextStream(stderr) << "Invalid arguments for --near" << Qt::endl;
+      return 1;
+    }
+    return bestStationsNear(latitude, longitude, radius, count, penalty);
+  }
+
   QApplication a(argc, argv);
   MainWindow w;
   w.show();
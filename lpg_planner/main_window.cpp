@@ -3,7 +3,9 @@
 
 #include <QMenuBar>
 #include <QMessageBox>
+#include <QProgressDialog>
 #include <QQuickItem>
+#include <QThread>
 #include <QTimer>
 
 
@@ -48,21 +50,29 @@ MainWindow::MainWindow(
       "will start in 'demo mode': paths will be straight lines and\n"
       "therefore the results will not be accurate!\n"
       "\n"
-      "Furthermore, please note that as of right now switching\n"
-      "between demo mode and regular mode will likely invalidate\n"
-      "the distance records in the local database. Before\n"
-      "activating regular mode, please makes sure to clear the\n"
-      "contents of the 'Distances' table (this will be done\n"
-      "automatically in future versions)."
+      "Distances computed in demo mode are stored separately, and\n"
+      "will not be used once an API key is provided."
     );
-    router_ = new RouterService(database_, this);
+    router_ = new RouterService(database_);
   }
   else {
-    router_ = new RouterOpenRouteService(database_, this);
+    router_ = new RouterOpenRouteService(database_);
   }
 
   // Create the planner.
-  planner_ = new LpgPlanner(router_, database_, this);
+  planner_ = new LpgPlanner(router_, database_);
+
+  // The router and the planner live in their own thread, so that the GUI
+  // stays responsive while planning; they can access the database since each
+  // thread has its own connection. Objects are moved to a thread without
+  // their parent, so they have none: they are deleted when the thread
+  // finishes.
+  planner_thread_ = new QThread(this);
+  router_->moveToThread(planner_thread_);
+  planner_->moveToThread(planner_thread_);
+  QObject::connect(planner_thread_, &QThread::finished, planner_, &QObject::deleteLater);
+  QObject::connect(planner_thread_, &QThread::finished, router_, &QObject::deleteLater);
+  planner_thread_->start();
 
   // Add the router widget.
   planner_widget_ = new LpgPlannerWidget(database_);
@@ -85,6 +95,32 @@ MainWindow::MainWindow(
   QObject::connect(planner_, SIGNAL(solved(LpgRoute)), planner_widget_, SLOT(showResult(LpgRoute)));
   QObject::connect(planner_, SIGNAL(failed(QString)), planner_widget_, SLOT(showError(QString)));
 
+  // The router lives in the planner thread, so it cannot show widgets: its
+  // signals are queued, and the dialogs are shown here, in the GUI thread.
+  QObject::connect(router_, &RouterService::busy, this, [this](bool waiting) {
+    if(waiting && progress_dialog_ == nullptr) {
+      progress_dialog_ = new QProgressDialog(
+        "A request has been sent to the routing service. Waiting for a reply, please wait...",
+        QString(),
+        0,
+        0,
+        this
+      );
+      progress_dialog_->setWindowTitle("Waiting for response");
+      progress_dialog_->setWindowModality(Qt::ApplicationModal);
+      progress_dialog_->setCancelButton(nullptr);
+      progress_dialog_->show();
+    }
+    else if(!waiting && progress_dialog_ != nullptr) {
+      progress_dialog_->close();
+      progress_dialog_->deleteLater();
+      progress_dialog_ = nullptr;
+    }
+  });
+  QObject::connect(router_, &RouterService::error, this, [this](const QString& message) {
+    QMessageBox::critical(this, "Routing Error", message);
+  });
+
   // Get the root object of the QML file, used for connections.
   QQuickItem* map_root_object = map_quick_widget_->rootObject();
 
@@ -129,18 +165,27 @@ MainWindow::MainWindow(
       // If we are actually using ORS, make sure the new key is used!
       RouterOpenRouteService* ors = dynamic_cast<RouterOpenRouteService*>(router_);
       if(ors != nullptr) {
-        ors->reloadKey();
+        QMetaObject::invokeMethod(ors, [ors]() { ors->reloadKey(); });
       }
       else {
         QMessageBox::information(
           this,
           "Demo Mode",
           "The API key for ORS has been changed, but the app was in\n"
-          "'demo mode'. To actually use OpenRouteService, please close\n"
-          "the app, clear the 'Distances' table in the database and\n"
+          "'demo mode'. To actually use OpenRouteService, please\n"
           "restart the application."
         );
       }
     }
   );
 }
+
+
+MainWindow::~MainWindow()
+{
+  // Stop the planner thread, waiting for the current plan (if any).
+  if(planner_thread_ != nullptr) {
+    planner_thread_->quit();
+    planner_thread_->wait();
+  }
+}
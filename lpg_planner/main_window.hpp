@@ -7,7 +7,9 @@
 #include "router_service.hpp"
 
 #include <QMainWindow>
+#include <QProgressDialog>
 #include <QQuickWidget>
+#include <QThread>
 
 
 class MainWindow : public QMainWindow {
@@ -16,11 +18,16 @@ class MainWindow : public QMainWindow {
 public:
   MainWindow(QWidget *parent = nullptr);
 
+  /// Stop the planner thread.
+  ~MainWindow();
+
 private:
   DatabaseManager* database_ = nullptr;
   RouterService* router_ = nullptr;
   LpgPlanner* planner_ = nullptr;
+  QThread* planner_thread_ = nullptr; ///< Thread of the router and the planner.
   LpgPlannerWidget* planner_widget_ = nullptr;
+  QProgressDialog* progress_dialog_ = nullptr; ///< Shown while the router is waiting for a reply.
   QQuickWidget* map_quick_widget_ = nullptr;
 };
 
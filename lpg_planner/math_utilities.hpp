@@ -2,6 +2,8 @@
 #define MATH_UTILITIES_HPP
 
 #include <Eigen/Dense>
+#include <cstdint>
+#include <limits>
 
 
 namespace math_utilities {
@@ -32,6 +34,53 @@ double longitude_variation(double distance_km, double latitude);
 Eigen::ArrayXXd loadArray(const std::string& filename);
 
 
+/// GPS coordinates in fixed-point format: one unit is 1e-6 degrees.
+/** Coordinates in the database have 6 decimal digits, so they are represented
+  * exactly (up to the rounding of the double they are read into). Any value
+  * in [-180, 180] degrees fits in 32 bits, and so does the difference of any
+  * two of them.
+  */
+using FixedPointArray = Eigen::Array<std::int32_t, Eigen::Dynamic, 1>;
+
+/// Number of fixed-point units in one degree.
+constexpr double FIXED_POINT_SCALE = 1e6;
+
+/// Convert a coordinate, in degrees, to fixed-point.
+/** The result is rounded to the nearest unit, so the conversion error is at
+  * most 0.5e-6 degrees (about 5.6 cm along a meridian).
+  * @param degrees A latitude or a longitude, in degrees.
+  * @return The same coordinate, in fixed-point format.
+  */
+std::int32_t toFixedPoint(double degrees);
+
+/// Convert an array of coordinates, in degrees, to fixed-point.
+/** @see toFixedPoint(double)
+  * @param degrees 1D array of latitudes or longitudes, in degrees.
+  * @return The same coordinates, in fixed-point format.
+  */
+template<class Derived>
+FixedPointArray toFixedPoint(const Eigen::ArrayBase<Derived>& degrees);
+
+/// Convert a fixed-point coordinate back to degrees.
+/** For coordinates with (at most) 6 decimal digits, this gives back the same
+  * double that was passed to toFixedPoint().
+  * @param fixed A latitude or a longitude, in fixed-point format.
+  * @return The same coordinate, in degrees.
+  */
+double fromFixedPoint(std::int32_t fixed);
+
+/// Convert a margin, in degrees, to a fixed-point one that is never smaller.
+/** Since both ends of a difference are rounded, the difference of two
+  * fixed-point coordinates is off by at most one unit. The returned margin
+  * accounts for that, so that a test like |a - b| <= margin never rejects
+  * points that pass the same test in floating point; it can accept points that
+  * are at most 2e-6 degrees (about 22 cm along a meridian) farther.
+  * @param degrees A non-negative margin, in degrees.
+  * @return The margin, in fixed-point format.
+  */
+std::int32_t toFixedPointMargin(double degrees);
+
+
 // Calculate the distance between GPS coordinates.
 /** This function calculates the distance between the given GPS coordinates.
   * It leverages Eigen's parallelization to allow computing multiple distances
@@ -75,6 +124,231 @@ auto haversineDistance(
 
 
 
+/// Policies to calculate the distance between GPS coordinates.
+/** Each policy is a class with a static method distance(lat1, lon1, lat2,
+  * lon2) that takes 1D arrays and returns the element-wise distances, in km,
+  * and an overload that takes the coordinates of a single pair of points.
+  * They are meant to be passed as template arguments to geoDistance(), so that
+  * each caller can choose the tradeoff between accuracy and speed at compile
+  * time:
+  * - Haversine: spherical model, accurate for any distance (the error due to
+  *   the spherical approximation is up to 0.5%).
+  * - SphericalLawOfCosines: same model, slightly cheaper, but it loses
+  *   precision for distances below a few meters.
+  * - Equirectangular: flat approximation around the mean latitude of the two
+  *   points; it is the cheapest one, and it is accurate for short distances
+  *   (the relative error is well below 0.1% up to ~100 km).
+  * - Vincenty: geodesic on the WGS84 ellipsoid, accurate to a fraction of a
+  *   millimeter, but iterative and evaluated one pair at a time.
+  */
+namespace distance_policy {
+
+/// Great-circle distance, using the haversine formula.
+struct Haversine {
+  static double distance(
+    double lat1,
+    double lon1,
+    double lat2,
+    double lon2
+  );
+
+  template <class D1, class D2, class D3, class D4>
+  static auto distance(
+    const Eigen::ArrayBase<D1>& lat1,
+    const Eigen::ArrayBase<D2>& lon1,
+    const Eigen::ArrayBase<D3>& lat2,
+    const Eigen::ArrayBase<D4>& lon2
+  );
+};
+
+/// Great-circle distance, using the spherical law of cosines.
+struct SphericalLawOfCosines {
+  static double distance(
+    double lat1,
+    double lon1,
+    double lat2,
+    double lon2
+  );
+
+  template <class D1, class D2, class D3, class D4>
+  static auto distance(
+    const Eigen::ArrayBase<D1>& lat1,
+    const Eigen::ArrayBase<D2>& lon1,
+    const Eigen::ArrayBase<D3>& lat2,
+    const Eigen::ArrayBase<D4>& lon2
+  );
+};
+
+/// Distance in the equirectangular projection centered at the mean latitude.
+struct Equirectangular {
+  static double distance(
+    double lat1,
+    double lon1,
+    double lat2,
+    double lon2
+  );
+
+  template <class D1, class D2, class D3, class D4>
+  static auto distance(
+    const Eigen::ArrayBase<D1>& lat1,
+    const Eigen::ArrayBase<D2>& lon1,
+    const Eigen::ArrayBase<D3>& lat2,
+    const Eigen::ArrayBase<D4>& lon2
+  );
+};
+
+/// Geodesic distance on the WGS84 ellipsoid, using Vincenty's formulae.
+/** If the iteration does not converge (which can only happen for nearly
+  * antipodal points) the haversine distance is returned.
+  */
+struct Vincenty {
+  static double distance(
+    double lat1,
+    double lon1,
+    double lat2,
+    double lon2
+  );
+
+  template <class D1, class D2, class D3, class D4>
+  static Eigen::ArrayXd distance(
+    const Eigen::ArrayBase<D1>& lat1,
+    const Eigen::ArrayBase<D2>& lon1,
+    const Eigen::ArrayBase<D3>& lat2,
+    const Eigen::ArrayBase<D4>& lon2
+  );
+};
+
+} // namespace distance_policy
+
+
+/// Calculate the distance between GPS coordinates, using the given policy.
+/** @see distance_policy
+  * @param lat1 1D array of latitudes.
+  * @param lon1 1D array of longitudes.
+  * @param lat2 1D array of latitudes.
+  * @param lon2 1D array of longitudes.
+  * @return An array with the same shape as the inputs, such that the i-th
+  *   entry is the distance between the points defined by (lat1(i), lon1(i))
+  *   and (lat2(i), lon2(i)).
+  */
+template <class Policy, class D1, class D2, class D3, class D4>
+auto geoDistance(
+  const Eigen::ArrayBase<D1>& lat1,
+  const Eigen::ArrayBase<D2>& lon1,
+  const Eigen::ArrayBase<D3>& lat2,
+  const Eigen::ArrayBase<D4>& lon2
+);
+
+/// Calculate the distance between GPS coordinates, using the given policy.
+/** This overloaded version allows to calculate the distance between a set of
+  * points from a single point.
+  * @see geoDistance()
+  * @param lat1 1D array of latitudes.
+  * @param lon1 1D array of longitudes.
+  * @param lat2 A latitude.
+  * @param lon2 A longitude.
+  * @return An array with the same shape as the first inputs, such that the
+  *   i-th entry is the distance between the points defined by
+  *   (lat1(i), lon1(i)) and (lat2, lon2).
+  */
+template <class Policy, class D1, class D2>
+auto geoDistance(
+  const Eigen::ArrayBase<D1>& lat1,
+  const Eigen::ArrayBase<D2>& lon1,
+  double lat2,
+  double lon2
+);
+
+
+
+/// Simplify a polyline given as a sequence of GPS coordinates.
+/** Uses the Douglas-Peucker algorithm to remove vertices from a polyline, so
+  * that every removed vertex lies within the given tolerance from the
+  * simplified polyline. The farthest vertex from each segment is found in a
+  * local equirectangular projection; its distance from the segment, and the
+  * length of the segment, are then measured with the given policy. With the
+  * default one, the projected distances are used as they are.
+  *
+  * Since many computations only look at the vertices of a path, segments
+  * longer than max_spacing_km are split as well, even if they are within the
+  * tolerance (as long as the original polyline has vertices to split them).
+  * @param latitudes 1D array of latitudes of the polyline vertices.
+  * @param longitudes 1D array of longitudes of the polyline vertices. It must
+  *   have the same size as latitudes.
+  * @param tolerance_km Maximum distance, in km, between a removed vertex and
+  *   the simplified polyline.
+  * @param max_spacing_km Desired maximum distance, in km, between consecutive
+  *   vertices of the simplified polyline.
+  * @return The sorted list of indices of the vertices to be kept. The first
+  *   and last vertices are always part of the list.
+  * @tparam Policy One of the distance_policy classes.
+  */
+template<class Policy = distance_policy::Equirectangular, class D1, class D2>
+std::vector<Eigen::Index> simplifyPolyline(
+  const Eigen::ArrayBase<D1>& latitudes,
+  const Eigen::ArrayBase<D2>& longitudes,
+  double tolerance_km,
+  double max_spacing_km = std::numeric_limits<double>::infinity()
+);
+
+
+/// Calculate the distance between a location and a polyline.
+/** The distance is measured to the closest point of the polyline, which can
+  * lie anywhere along a segment, not only at a vertex. The closest point is
+  * found in a local equirectangular projection centered at the location, and
+  * its distance from the location is then measured with the given policy.
+  * With the default one, the projected distance is returned as it is, which
+  * is accurate enough for the short distances between a path and the
+  * stations near it.
+  * @param latitudes 1D array of latitudes of the polyline vertices. It must
+  *   contain at least one vertex.
+  * @param longitudes 1D array of longitudes of the polyline vertices. It must
+  *   have the same size as latitudes.
+  * @param latitude Latitude of the location.
+  * @param longitude Longitude of the location.
+  * @param[out] segment Index of the segment that contains the closest point,
+  *   i.e., the one from vertex 'segment' to vertex 'segment+1'.
+  * @param[out] fraction Position of the closest point along the segment, from
+  *   0 (at vertex 'segment') to 1 (at vertex 'segment+1').
+  * @return The distance, in km, between the location and the closest point.
+  * @tparam Policy One of the distance_policy classes.
+  */
+template<class Policy = distance_policy::Equirectangular, class D1, class D2>
+double polylineDistance(
+  const Eigen::ArrayBase<D1>& latitudes,
+  const Eigen::ArrayBase<D2>& longitudes,
+  double latitude,
+  double longitude,
+  Eigen::Index& segment,
+  double& fraction
+);
+
+
+/// Find the points that are not dominated by any of their neighbours.
+/** Point j dominates point i if it has both a strictly smaller cost and a
+  * strictly smaller penalty, and if their positions are at most 'window'
+  * apart. The neighbours of each point are found with two monotonic pointers,
+  * then the points are visited by increasing cost: a segment tree over the
+  * positions stores the minimum penalty of the points visited so far, so that
+  * each point only needs a range query over its neighbours. This takes
+  * O(n log n) time, whatever the number of neighbours.
+  * @param positions 1D array of positions of the points, sorted in ascending
+  *   order.
+  * @param costs 1D array of costs, one per point.
+  * @param penalties 1D array of penalties, one per point.
+  * @param window Maximum distance between a point and those that can
+  *   dominate it.
+  * @return A list of flags, true for the points that are not dominated.
+  */
+template<class D1, class D2, class D3>
+std::vector<bool> skyline(
+  const Eigen::ArrayBase<D1>& positions,
+  const Eigen::ArrayBase<D2>& costs,
+  const Eigen::ArrayBase<D3>& penalties,
+  double window
+);
+
+
 /// Return the array that would order the input.
 /** Given an input array, return the sequence s = (s0, s1, s2, ...) such that
   * the sequence (array(s0), array(s1), array(s2), ...) is sorted in ascending
@@ -108,6 +382,48 @@ void sortBy(
 );
 
 
+/// Return the array that would order the input, for small integer keys.
+/** This is equivalent to argsort(), but uses counting sort: it is meant for
+  * arrays of non-negative integers bounded by some (small) value, such as
+  * indices of points in a path. The ordering is stable.
+  * @see argsort()
+  * @param keys A 1D array of integers in the range [0, max_key].
+  * @param max_key Largest value that can appear in the input.
+  * @return A list of indices which would sort the input. It is computed in
+  *   O(n + max_key).
+  */
+template<class Derived>
+std::vector<Eigen::Index> countingArgsort(
+  const Eigen::ArrayBase<Derived>& keys,
+  Eigen::Index max_key
+);
+
+/// Reorder any number of arrays according to the given ordering.
+/** Given the sequence idx = (i0, i1, i2, ...), reorder each input array as
+  * (array[i0], array[i1], array[i2], ...). Arrays are modified in-place by
+  * following the cycles of the permutation, so that each element is moved
+  * exactly once and no copy of the arrays is needed. Any container with
+  * operator[] and a value_type can be used, e.g., 1D Eigen arrays,
+  * std::vector (including std::vector<bool>) or QList.
+  *
+  * To sort several arrays according to the content of the first one, use:
+  * ```
+  * auto order = countingArgsort(keys, max_key);
+  * permute(order, keys, values, other_values);
+  * ```
+  * @see sortBy()
+  * @param[in] idx List of indices telling how to sort the inputs. It must be
+  *   a permutation of (0, 1, ..., n-1).
+  * @param[in, out] arrays Arrays to be reordered. They must all have the same
+  *   size as idx.
+  */
+template<class... Arrays>
+void permute(
+  const std::vector<Eigen::Index>& idx,
+  Arrays&... arrays
+);
+
+
 } // namespace math_utilities
 
 #endif // MATH_UTILITIES_HPP
@@ -1,7 +1,11 @@
 #pragma once
 
 #include "math_utilities.hpp"
+#include <algorithm>
+#include <cmath>
 #include <fstream>
+#include <tuple>
+#include <type_traits>
 
 
 namespace math_utilities {
@@ -12,7 +16,7 @@ constexpr double TO_DEG = (180 / M_PI);
 constexpr double TO_RAD = (M_PI / 180);
 
 
-double latitude_variation(
+inline double latitude_variation(
   double distance_km
 )
 {
@@ -20,7 +24,7 @@ double latitude_variation(
 }
 
 
-double longitude_variation(
+inline double longitude_variation(
   double distance_km,
   double latitude
 )
@@ -29,7 +33,7 @@ double longitude_variation(
 }
 
 
-Eigen::ArrayXXd loadArray(const std::string& filename)
+inline Eigen::ArrayXXd loadArray(const std::string& filename)
 {
   // Open the file.
   std::ifstream file(filename);
@@ -61,6 +65,39 @@ Eigen::ArrayXXd loadArray(const std::string& filename)
 }
 
 
+inline std::int32_t toFixedPoint(
+  double degrees
+)
+{
+  return static_cast<std::int32_t>(std::lround(degrees * FIXED_POINT_SCALE));
+}
+
+
+template<class Derived>
+FixedPointArray toFixedPoint(
+  const Eigen::ArrayBase<Derived>& degrees
+)
+{
+  return (degrees * FIXED_POINT_SCALE).round().template cast<std::int32_t>();
+}
+
+
+inline double fromFixedPoint(
+  std::int32_t fixed
+)
+{
+  return fixed / FIXED_POINT_SCALE;
+}
+
+
+inline std::int32_t toFixedPointMargin(
+  double degrees
+)
+{
+  return static_cast<std::int32_t>(std::ceil(degrees * FIXED_POINT_SCALE)) + 1;
+}
+
+
 template <class D1, class D2, class D3, class D4>
 auto haversineDistance(
   const Eigen::ArrayBase<D1>& lat1,
@@ -110,6 +147,440 @@ auto haversineDistance(
 }
 
 
+namespace distance_policy {
+
+inline double Haversine::distance(
+  double lat1,
+  double lon1,
+  double lat2,
+  double lon2
+  )
+{
+  const double dlat = TO_RAD * (lat1 - lat2);
+  const double dlon = TO_RAD * (lon1 - lon2);
+  const double a =
+    std::pow(std::sin(dlat / 2), 2) +
+    std::cos(TO_RAD * lat1) * std::cos(TO_RAD * lat2) * std::pow(std::sin(dlon / 2), 2);
+  return 2.0 * EARTH_RADIUS_KM * std::asin(std::sqrt(a));
+}
+
+
+template <class D1, class D2, class D3, class D4>
+auto Haversine::distance(
+  const Eigen::ArrayBase<D1>& lat1,
+  const Eigen::ArrayBase<D2>& lon1,
+  const Eigen::ArrayBase<D3>& lat2,
+  const Eigen::ArrayBase<D4>& lon2
+  )
+{
+  return haversineDistance(lat1, lon1, lat2, lon2);
+}
+
+
+inline double SphericalLawOfCosines::distance(
+  double lat1,
+  double lon1,
+  double lat2,
+  double lon2
+  )
+{
+  const double c =
+    std::sin(TO_RAD * lat1) * std::sin(TO_RAD * lat2) +
+    std::cos(TO_RAD * lat1) * std::cos(TO_RAD * lat2) * std::cos(TO_RAD * (lon1 - lon2));
+  return EARTH_RADIUS_KM * std::acos(std::clamp(c, -1.0, 1.0));
+}
+
+
+template <class D1, class D2, class D3, class D4>
+auto SphericalLawOfCosines::distance(
+  const Eigen::ArrayBase<D1>& lat1,
+  const Eigen::ArrayBase<D2>& lon1,
+  const Eigen::ArrayBase<D3>& lat2,
+  const Eigen::ArrayBase<D4>& lon2
+  )
+{
+  // Convert to radians.
+  auto lat1r = TO_RAD * lat1.array();
+  auto lat2r = TO_RAD * lat2.array();
+  auto dlon = TO_RAD * (lon1.array() - lon2.array());
+
+  // Cosine of the central angle; rounding can push it slightly outside of
+  // [-1, 1] for (nearly) coincident points.
+  auto c = lat1r.sin() * lat2r.sin() + lat1r.cos() * lat2r.cos() * dlon.cos();
+  return EARTH_RADIUS_KM * c.min(1.0).max(-1.0).acos();
+}
+
+
+inline double Equirectangular::distance(
+  double lat1,
+  double lon1,
+  double lat2,
+  double lon2
+  )
+{
+  const double x = TO_RAD * (lon1 - lon2) * std::cos(TO_RAD * 0.5 * (lat1 + lat2));
+  const double y = TO_RAD * (lat1 - lat2);
+  return EARTH_RADIUS_KM * std::sqrt(x * x + y * y);
+}
+
+
+template <class D1, class D2, class D3, class D4>
+auto Equirectangular::distance(
+  const Eigen::ArrayBase<D1>& lat1,
+  const Eigen::ArrayBase<D2>& lon1,
+  const Eigen::ArrayBase<D3>& lat2,
+  const Eigen::ArrayBase<D4>& lon2
+  )
+{
+  // Project the differences on the plane tangent at the mean latitude.
+  auto x = TO_RAD * (lon1.array() - lon2.array()) * (TO_RAD * 0.5 * (lat1.array() + lat2.array())).cos();
+  auto y = TO_RAD * (lat1.array() - lat2.array());
+  return EARTH_RADIUS_KM * (x.square() + y.square()).sqrt();
+}
+
+
+inline double Vincenty::distance(
+  double lat1,
+  double lon1,
+  double lat2,
+  double lon2
+  )
+{
+  // WGS84 ellipsoid.
+  constexpr double A = 6378.137;
+  constexpr double F = 1 / 298.257223563;
+  constexpr double B = A * (1 - F);
+  constexpr int MAX_ITERATIONS = 100;
+  constexpr double TOLERANCE = 1e-12;
+
+  // Reduced latitudes.
+  const double L = TO_RAD * (lon2 - lon1);
+  const double U1 = std::atan((1 - F) * std::tan(TO_RAD * lat1));
+  const double U2 = std::atan((1 - F) * std::tan(TO_RAD * lat2));
+  const double sinU1 = std::sin(U1), cosU1 = std::cos(U1);
+  const double sinU2 = std::sin(U2), cosU2 = std::cos(U2);
+
+  // Iterate on the longitude difference on the auxiliary sphere.
+  double lambda = L;
+  double sin_sigma, cos_sigma, sigma, cos2_alpha, cos_2sigma_m;
+  for(int iteration=0; ; iteration++) {
+    if(iteration == MAX_ITERATIONS) {
+      return Haversine::distance(lat1, lon1, lat2, lon2);
+    }
+
+    const double sin_lambda = std::sin(lambda), cos_lambda = std::cos(lambda);
+    sin_sigma = std::sqrt(
+      (cosU2 * sin_lambda) * (cosU2 * sin_lambda) +
+      (cosU1 * sinU2 - sinU1 * cosU2 * cos_lambda) * (cosU1 * sinU2 - sinU1 * cosU2 * cos_lambda)
+    );
+    if(sin_sigma == 0) {
+      // Coincident points.
+      return 0.0;
+    }
+    cos_sigma = sinU1 * sinU2 + cosU1 * cosU2 * cos_lambda;
+    sigma = std::atan2(sin_sigma, cos_sigma);
+    const double sin_alpha = cosU1 * cosU2 * sin_lambda / sin_sigma;
+    cos2_alpha = 1 - sin_alpha * sin_alpha;
+    // On the equator cos2_alpha is zero, and so is the correction term.
+    cos_2sigma_m = cos2_alpha != 0 ? cos_sigma - 2 * sinU1 * sinU2 / cos2_alpha : 0.0;
+    const double C = F / 16 * cos2_alpha * (4 + F * (4 - 3 * cos2_alpha));
+    const double previous_lambda = lambda;
+    lambda = L + (1 - C) * F * sin_alpha * (
+      sigma + C * sin_sigma * (cos_2sigma_m + C * cos_sigma * (-1 + 2 * cos_2sigma_m * cos_2sigma_m))
+    );
+    if(std::abs(lambda - previous_lambda) < TOLERANCE) {
+      break;
+    }
+  }
+
+  // Length of the geodesic.
+  const double u2 = cos2_alpha * (A * A - B * B) / (B * B);
+  const double k_a = 1 + u2 / 16384 * (4096 + u2 * (-768 + u2 * (320 - 175 * u2)));
+  const double k_b = u2 / 1024 * (256 + u2 * (-128 + u2 * (74 - 47 * u2)));
+  const double delta_sigma = k_b * sin_sigma * (
+    cos_2sigma_m + k_b / 4 * (
+      cos_sigma * (-1 + 2 * cos_2sigma_m * cos_2sigma_m) -
+      k_b / 6 * cos_2sigma_m * (-3 + 4 * sin_sigma * sin_sigma) * (-3 + 4 * cos_2sigma_m * cos_2sigma_m)
+    )
+  );
+  return B * k_a * (sigma - delta_sigma);
+}
+
+
+template <class D1, class D2, class D3, class D4>
+Eigen::ArrayXd Vincenty::distance(
+  const Eigen::ArrayBase<D1>& lat1,
+  const Eigen::ArrayBase<D2>& lon1,
+  const Eigen::ArrayBase<D3>& lat2,
+  const Eigen::ArrayBase<D4>& lon2
+  )
+{
+  // The iteration cannot be vectorized, so evaluate one pair at a time.
+  Eigen::ArrayXd result(lat1.size());
+  for(Eigen::Index i=0; i<lat1.size(); i++) {
+    result(i) = distance(lat1(i), lon1(i), lat2(i), lon2(i));
+  }
+  return result;
+}
+
+} // namespace distance_policy
+
+
+template <class Policy, class D1, class D2, class D3, class D4>
+auto geoDistance(
+  const Eigen::ArrayBase<D1>& lat1,
+  const Eigen::ArrayBase<D2>& lon1,
+  const Eigen::ArrayBase<D3>& lat2,
+  const Eigen::ArrayBase<D4>& lon2
+  )
+{
+  return Policy::distance(lat1, lon1, lat2, lon2);
+}
+
+
+// Scalar version of the above.
+template <class Policy, class D1, class D2>
+auto geoDistance(
+  const Eigen::ArrayBase<D1>& lat1,
+  const Eigen::ArrayBase<D2>& lon1,
+  double lat2,
+  double lon2
+  )
+{
+  // Same trick as in haversineDistance().
+  return Policy::distance(
+    lat1,
+    lon1,
+    (lat1*0 + lat2),
+    (lon1*0 + lon2)
+  );
+}
+
+
+template<class Policy, class D1, class D2>
+std::vector<Eigen::Index> simplifyPolyline(
+  const Eigen::ArrayBase<D1>& latitudes,
+  const Eigen::ArrayBase<D2>& longitudes,
+  double tolerance_km,
+  double max_spacing_km
+)
+{
+  // Nothing to simplify if there are no intermediate vertices.
+  const Eigen::Index n = latitudes.size();
+  if(n <= 2 || tolerance_km <= 0) {
+    std::vector<Eigen::Index> all_idx(n);
+    for(Eigen::Index i=0; i<n; ++i) {
+      all_idx[i] = i;
+    }
+    return all_idx;
+  }
+
+  // Flags telling which vertices survive. The extremities always do.
+  std::vector<bool> keep(n, false);
+  keep[0] = true;
+  keep[n-1] = true;
+
+  // Iterative version of Douglas-Peucker: each element of the stack is a
+  // pair of kept vertices, and we look for the farthest vertex in between.
+  std::vector<std::pair<Eigen::Index, Eigen::Index>> stack{{0, n-1}};
+  const double tolerance_squared = tolerance_km * tolerance_km;
+
+  while(!stack.empty()) {
+    auto [first, last] = stack.back();
+    stack.pop_back();
+    if(last - first < 2) {
+      continue;
+    }
+
+    // Scale factors for a local projection centered on the first vertex.
+    const double ky = EARTH_RADIUS_KM * TO_RAD;
+    const double kx = ky * std::cos(TO_RAD * 0.5 * (latitudes(first) + latitudes(last)));
+
+    // Projected segment from the first to the last vertex.
+    const double bx = kx * (longitudes(last) - longitudes(first));
+    const double by = ky * (latitudes(last) - latitudes(first));
+    const double b_squared = bx*bx + by*by;
+
+    // Locate the vertex that is farthest from the segment.
+    double max_distance_squared = -1.0;
+    double farthest_t = 0.0;
+    Eigen::Index farthest = first;
+    for(Eigen::Index i=first+1; i<last; ++i) {
+      const double px = kx * (longitudes(i) - longitudes(first));
+      const double py = ky * (latitudes(i) - latitudes(first));
+      const double t = b_squared > 0 ? std::clamp((px*bx + py*by) / b_squared, 0.0, 1.0) : 0.0;
+      const double dx = px - t*bx;
+      const double dy = py - t*by;
+      const double distance_squared = dx*dx + dy*dy;
+      if(distance_squared > max_distance_squared) {
+        max_distance_squared = distance_squared;
+        farthest_t = t;
+        farthest = i;
+      }
+    }
+
+    // Measure the distance of the farthest vertex and the length of the
+    // segment with the policy, unless the projected ones are enough.
+    double length_squared = b_squared;
+    if constexpr(!std::is_same_v<Policy, distance_policy::Equirectangular>) {
+      const double distance = Policy::distance(
+        latitudes(farthest),
+        longitudes(farthest),
+        latitudes(first) + farthest_t * (latitudes(last) - latitudes(first)),
+        longitudes(first) + farthest_t * (longitudes(last) - longitudes(first))
+      );
+      const double length = Policy::distance(latitudes(first), longitudes(first), latitudes(last), longitudes(last));
+      max_distance_squared = distance * distance;
+      length_squared = length * length;
+    }
+
+    // If the farthest vertex is too far, keep it and split the polyline. If
+    // the segment is too long, split it in the middle.
+    if(max_distance_squared <= tolerance_squared && length_squared > max_spacing_km * max_spacing_km) {
+      farthest = (first + last) / 2;
+      max_distance_squared = std::numeric_limits<double>::infinity();
+    }
+    if(max_distance_squared > tolerance_squared) {
+      keep[farthest] = true;
+      stack.push_back({first, farthest});
+      stack.push_back({farthest, last});
+    }
+  }
+
+  // Gather the indices of the vertices that have been kept.
+  std::vector<Eigen::Index> kept_idx;
+  for(Eigen::Index i=0; i<n; ++i) {
+    if(keep[i]) {
+      kept_idx.push_back(i);
+    }
+  }
+  return kept_idx;
+}
+
+
+template<class Policy, class D1, class D2>
+double polylineDistance(
+  const Eigen::ArrayBase<D1>& latitudes,
+  const Eigen::ArrayBase<D2>& longitudes,
+  double latitude,
+  double longitude,
+  Eigen::Index& segment,
+  double& fraction
+)
+{
+  // Scale factors for a local projection centered on the location; vertices
+  // are expressed relative to the location itself.
+  const double ky = EARTH_RADIUS_KM * TO_RAD;
+  const double kx = ky * std::cos(TO_RAD * latitude);
+  auto x = kx * (longitudes - longitude);
+  auto y = ky * (latitudes - latitude);
+
+  // A single vertex has no segments.
+  const Eigen::Index m = latitudes.size() - 1;
+  segment = 0;
+  fraction = 0.0;
+  if(m == 0) {
+    if constexpr(std::is_same_v<Policy, distance_policy::Equirectangular>) {
+      return std::sqrt(x(0)*x(0) + y(0)*y(0));
+    }
+    else {
+      return Policy::distance(latitudes(0), longitudes(0), latitude, longitude);
+    }
+  }
+
+  // The i-th segment goes from a = (x(i), y(i)) to a + b. Its closest point to
+  // the origin is a + t*b, where t is the projection of the origin on the
+  // segment, clamped to [0, 1] (degenerate segments are reduced to a). All
+  // expressions are evaluated in a single pass, without temporaries.
+  auto bx = x.tail(m) - x.head(m);
+  auto by = y.tail(m) - y.head(m);
+  auto b_squared = bx.square() + by.square();
+  auto t = (b_squared > 0).select(-(x.head(m)*bx + y.head(m)*by) / b_squared, 0.0).max(0.0).min(1.0);
+  const double distance_squared = ((x.head(m) + t*bx).square() + (y.head(m) + t*by).square()).minCoeff(&segment);
+  fraction = t(segment, 0); // Select expressions only allow 2D access.
+
+  // Measure the distance from the closest point with the policy, unless the
+  // projected one is enough.
+  if constexpr(std::is_same_v<Policy, distance_policy::Equirectangular>) {
+    return std::sqrt(distance_squared);
+  }
+  else {
+    return Policy::distance(
+      latitudes(segment) + fraction * (latitudes(segment+1) - latitudes(segment)),
+      longitudes(segment) + fraction * (longitudes(segment+1) - longitudes(segment)),
+      latitude,
+      longitude
+    );
+  }
+}
+
+
+template<class D1, class D2, class D3>
+std::vector<bool> skyline(
+  const Eigen::ArrayBase<D1>& positions,
+  const Eigen::ArrayBase<D2>& costs,
+  const Eigen::ArrayBase<D3>& penalties,
+  double window
+)
+{
+  const Eigen::Index n = positions.size();
+  std::vector<bool> not_dominated(n, true);
+
+  // Neighbours of point i are in the range [lo[i], hi[i]).
+  std::vector<Eigen::Index> lo(n);
+  std::vector<Eigen::Index> hi(n);
+  for(Eigen::Index i=0, l=0, h=0; i<n; ++i) {
+    while(positions(l) < positions(i) - window) {
+      ++l;
+    }
+    while(h < n && positions(h) <= positions(i) + window) {
+      ++h;
+    }
+    lo[i] = l;
+    hi[i] = h;
+  }
+
+  // Bottom-up segment tree: leaf n+j holds the penalty of point j once it has
+  // been visited, and each inner node the minimum of its children.
+  std::vector<double> tree(2*n, std::numeric_limits<double>::infinity());
+
+  // Points are visited by increasing cost. Points with the same cost cannot
+  // dominate each other, so all of them are tested before any is inserted.
+  const std::vector<Eigen::Index> order = argsort(costs);
+  for(Eigen::Index first=0, last=0; first<n; first=last) {
+    while(last < n && costs(order[last]) == costs(order[first])) {
+      ++last;
+    }
+
+    // A point is dominated if a cheaper neighbour has a smaller penalty.
+    for(Eigen::Index k=first; k<last; ++k) {
+      const Eigen::Index i = order[k];
+      double min_penalty = std::numeric_limits<double>::infinity();
+      for(Eigen::Index l=lo[i]+n, h=hi[i]+n; l<h; l/=2, h/=2) {
+        if(l % 2 == 1) {
+          min_penalty = std::min(min_penalty, tree[l++]);
+        }
+        if(h % 2 == 1) {
+          min_penalty = std::min(min_penalty, tree[--h]);
+        }
+      }
+      not_dominated[i] = !(min_penalty < penalties(i));
+    }
+
+    // Insert the points, updating the minima up to the root.
+    for(Eigen::Index k=first; k<last; ++k) {
+      Eigen::Index node = order[k] + n;
+      tree[node] = penalties(order[k]);
+      for(node/=2; node>=1; node/=2) {
+        tree[node] = std::min(tree[2*node], tree[2*node+1]);
+      }
+    }
+  }
+
+  return not_dominated;
+}
+
+
 template<class Derived>
 std::vector<Eigen::Index> argsort(
   const Eigen::ArrayBase<Derived>& array
@@ -146,4 +617,66 @@ void sortBy(
   }
 }
 
+template<class Derived>
+std::vector<Eigen::Index> countingArgsort(
+  const Eigen::ArrayBase<Derived>& keys,
+  Eigen::Index max_key
+)
+{
+  // Count the occurrences of each key, then transform the counts into the
+  // position of the first element with the given key in the sorted output.
+  std::vector<Eigen::Index> first_position(max_key + 2, 0);
+  for(Eigen::Index i=0; i<keys.size(); ++i) {
+    eigen_assert(keys(i) >= 0 && keys(i) <= max_key && "countingArgsort(keys, max_key): KEY OUT OF RANGE");
+    first_position[keys(i) + 1]++;
+  }
+  for(Eigen::Index k=1; k<first_position.size(); ++k) {
+    first_position[k] += first_position[k-1];
+  }
+
+  // Place each index at its final position. Scanning the input in order
+  // makes the sort stable.
+  std::vector<Eigen::Index> sorted_idx(keys.size());
+  for(Eigen::Index i=0; i<keys.size(); ++i) {
+    sorted_idx[first_position[keys(i)]++] = i;
+  }
+
+  return sorted_idx;
+}
+
+
+template<class... Arrays>
+void permute(
+  const std::vector<Eigen::Index>& idx,
+  Arrays&... arrays
+)
+{
+  // Flags telling which positions already contain their final value.
+  std::vector<bool> done(idx.size(), false);
+
+  for(std::size_t start=0; start<idx.size(); ++start) {
+    if(done[start]) {
+      continue;
+    }
+
+    // Save the values at the start of the cycle, as they are the first to be
+    // overwritten. The value type is used rather than the type of operator[],
+    // which is a proxy for some containers (e.g., std::vector<bool>).
+    auto saved = std::make_tuple(typename std::decay_t<Arrays>::value_type(arrays[start])...);
+
+    // Follow the cycle, pulling each value from the position it comes from.
+    std::size_t current = start;
+    while(static_cast<std::size_t>(idx[current]) != start) {
+      std::size_t next = idx[current];
+      ((arrays[current] = arrays[next]), ...);
+      done[current] = true;
+      current = next;
+    }
+
+    // Close the cycle with the saved values.
+    std::apply([&](const auto&... values) { ((arrays[current] = values), ...); }, saved);
+    done[current] = true;
+  }
+}
+
 } // namespace math_utilities
@@ -0,0 +1,159 @@
+#include "path_geometry.hpp"
+
+#include <QSharedData>
+#include <QtDebug>
+
+
+/// Shared data of PathGeometry.
+class PathGeometryData : public QSharedData {
+public:
+  Eigen::ArrayXd latitudes; ///< Latitudes of the points.
+  Eigen::ArrayXd longitudes; ///< Longitudes of the points.
+  math_utilities::FixedPointArray fixed_latitudes; ///< Latitudes of the points, in fixed-point format.
+  math_utilities::FixedPointArray fixed_longitudes; ///< Longitudes of the points, in fixed-point format.
+  Eigen::ArrayXd segment_lengths; ///< Distance between consecutive points.
+  Eigen::ArrayXd arclength; ///< Cumulative distance from the first point.
+  PathGeometry::BoundingBox bounds; ///< Bounding box of the whole path.
+  std::vector<PathGeometry::BoundingBox> chunk_bounds; ///< Bounding box of each chunk.
+};
+
+
+PathGeometry::PathGeometry() : d(new PathGeometryData)
+{
+  // Nothing to do here.
+}
+
+
+PathGeometry::PathGeometry(
+  const QList<double>& latitudes,
+  const QList<double>& longitudes
+) : d(new PathGeometryData)
+{
+  if(latitudes.size() != longitudes.size()) {
+    qDebug() << "Cannot create a path from latitudes and longitudes with different sizes";
+    return;
+  }
+
+  // Copy the coordinates.
+  const Eigen::Index n = latitudes.size();
+  d->latitudes = Eigen::Map<const Eigen::ArrayXd>(latitudes.data(), n);
+  d->longitudes = Eigen::Map<const Eigen::ArrayXd>(longitudes.data(), n);
+  d->fixed_latitudes = math_utilities::toFixedPoint(d->latitudes);
+  d->fixed_longitudes = math_utilities::toFixedPoint(d->longitudes);
+
+  if(n == 0) {
+    return;
+  }
+
+  // Distances between consecutive points, and their cumulative sum.
+  d->segment_lengths = math_utilities::haversineDistance(
+    d->latitudes.head(n-1),
+    d->longitudes.head(n-1),
+    d->latitudes.tail(n-1),
+    d->longitudes.tail(n-1)
+  );
+  d->arclength.resize(n);
+  d->arclength(0) = 0;
+  for(Eigen::Index i=1; i<n; i++) {
+    d->arclength(i) = d->arclength(i-1) + d->segment_lengths(i-1);
+  }
+
+  // Bounding box of each chunk, and of the whole path. Chunks also include
+  // the first point of the next one, so that their boxes contain all the
+  // segments that start in them.
+  d->chunk_bounds.resize((n + CHUNK_SIZE - 1) / CHUNK_SIZE);
+  for(Eigen::Index c=0; c<d->chunk_bounds.size(); c++) {
+    Eigen::Index first = c * CHUNK_SIZE;
+    Eigen::Index count = std::min(CHUNK_SIZE + 1, n - first);
+    BoundingBox& box = d->chunk_bounds[c];
+    box.min_latitude = d->latitudes.segment(first, count).minCoeff();
+    box.max_latitude = d->latitudes.segment(first, count).maxCoeff();
+    box.min_longitude = d->longitudes.segment(first, count).minCoeff();
+    box.max_longitude = d->longitudes.segment(first, count).maxCoeff();
+
+    d->bounds.min_latitude = std::min(d->bounds.min_latitude, box.min_latitude);
+    d->bounds.max_latitude = std::max(d->bounds.max_latitude, box.max_latitude);
+    d->bounds.min_longitude = std::min(d->bounds.min_longitude, box.min_longitude);
+    d->bounds.max_longitude = std::max(d->bounds.max_longitude, box.max_longitude);
+  }
+}
+
+
+PathGeometry::PathGeometry(const PathGeometry& other) = default;
+PathGeometry& PathGeometry::operator=(const PathGeometry& other) = default;
+PathGeometry::~PathGeometry() = default;
+
+
+bool PathGeometry::isEmpty() const
+{
+  return d->latitudes.size() == 0;
+}
+
+
+Eigen::Index PathGeometry::size() const
+{
+  return d->latitudes.size();
+}
+
+
+const Eigen::ArrayXd& PathGeometry::latitudes() const
+{
+  return d->latitudes;
+}
+
+
+const Eigen::ArrayXd& PathGeometry::longitudes() const
+{
+  return d->longitudes;
+}
+
+
+const math_utilities::FixedPointArray& PathGeometry::fixedLatitudes() const
+{
+  return d->fixed_latitudes;
+}
+
+
+const math_utilities::FixedPointArray& PathGeometry::fixedLongitudes() const
+{
+  return d->fixed_longitudes;
+}
+
+
+const Eigen::ArrayXd& PathGeometry::segmentLengths() const
+{
+  return d->segment_lengths;
+}
+
+
+const Eigen::ArrayXd& PathGeometry::arclength() const
+{
+  return d->arclength;
+}
+
+
+double PathGeometry::length() const
+{
+  return isEmpty() ? 0.0 : d->arclength(d->arclength.size()-1);
+}
+
+
+const PathGeometry::BoundingBox& PathGeometry::bounds() const
+{
+  return d->bounds;
+}
+
+
+Eigen::Index PathGeometry::chunkCount() const
+{
+  return d->chunk_bounds.size();
+}
+
+
+const PathGeometry::BoundingBox& PathGeometry::chunkBounds(
+  Eigen::Index chunk
+) const
+{
+  return d->chunk_bounds[chunk];
+}
+
@@ -0,0 +1,193 @@
+#ifndef PATH_GEOMETRY_HPP
+#define PATH_GEOMETRY_HPP
+
+#include "math_utilities.hpp"
+
+#include <Eigen/Dense>
+#include <QList>
+#include <QSharedDataPointer>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+
+class PathGeometryData;
+
+
+/// Immutable driving path, alongside quantities that are often needed.
+/** Coordinates of the path are stored as two separate arrays, alongside the
+  * length of each segment, the cumulative arclength and bounding boxes. All
+  * quantities are calculated once, when the object is created.
+  *
+  * Points are grouped into chunks of (at most) CHUNK_SIZE consecutive points,
+  * each with the bounding box of the segments that start in it (i.e., of its
+  * points and of the first point of the next chunk). These allow to skip
+  * large portions of the path when looking for points that are close to a
+  * given location.
+  *
+  * Coordinates are also available in fixed-point format, which is half the
+  * size of doubles and is meant for the kernels that scan many points, such
+  * as the corridor test against the stations in StationIndex.
+  *
+  * The class uses implicit sharing: copies are cheap, and since the path
+  * cannot be modified after construction, they never detach.
+  */
+class PathGeometry {
+public:
+  /// Axis-aligned box in GPS coordinates.
+  struct BoundingBox {
+    double min_latitude = 90.0;
+    double max_latitude = -90.0;
+    double min_longitude = 180.0;
+    double max_longitude = -180.0;
+
+    /// Tell if a location is inside the box, enlarged by the given margins.
+    inline bool contains(double latitude, double longitude, double latitude_margin = 0.0, double longitude_margin = 0.0) const {
+      return latitude >= min_latitude - latitude_margin && latitude <= max_latitude + latitude_margin
+        && longitude >= min_longitude - longitude_margin && longitude <= max_longitude + longitude_margin;
+    }
+
+    /// Tell if this box and the given one have at least one point in common.
+    inline bool intersects(const BoundingBox& other) const {
+      return min_latitude <= other.max_latitude && other.min_latitude <= max_latitude
+        && min_longitude <= other.max_longitude && other.min_longitude <= max_longitude;
+    }
+
+    /// Enlarge the box, so that it contains the given location.
+    inline void extend(double latitude, double longitude) {
+      min_latitude = std::min(min_latitude, latitude);
+      max_latitude = std::max(max_latitude, latitude);
+      min_longitude = std::min(min_longitude, longitude);
+      max_longitude = std::max(max_longitude, longitude);
+    }
+  };
+
+  /// Axis-aligned box in fixed-point GPS coordinates.
+  /** @see math_utilities::toFixedPoint() */
+  struct FixedBoundingBox {
+    std::int32_t min_latitude = std::numeric_limits<std::int32_t>::max();
+    std::int32_t max_latitude = std::numeric_limits<std::int32_t>::min();
+    std::int32_t min_longitude = std::numeric_limits<std::int32_t>::max();
+    std::int32_t max_longitude = std::numeric_limits<std::int32_t>::min();
+
+    /// Convert a box to fixed-point, rounding its sides to the nearest unit.
+    /** Locations within 0.5e-6 degrees from the sides can then be inside one
+      * box and outside the other one.
+      */
+    static inline FixedBoundingBox fromBox(const BoundingBox& box) {
+      return {
+        math_utilities::toFixedPoint(box.min_latitude),
+        math_utilities::toFixedPoint(box.max_latitude),
+        math_utilities::toFixedPoint(box.min_longitude),
+        math_utilities::toFixedPoint(box.max_longitude)
+      };
+    }
+
+    /// Tell if a location is inside the box.
+    inline bool contains(std::int32_t latitude, std::int32_t longitude) const {
+      return latitude >= min_latitude && latitude <= max_latitude
+        && longitude >= min_longitude && longitude <= max_longitude;
+    }
+
+    /// Tell if this box and the given one have at least one point in common.
+    inline bool intersects(const FixedBoundingBox& other) const {
+      return min_latitude <= other.max_latitude && other.min_latitude <= max_latitude
+        && min_longitude <= other.max_longitude && other.min_longitude <= max_longitude;
+    }
+
+    /// Enlarge the box, so that it contains the given location.
+    inline void extend(std::int32_t latitude, std::int32_t longitude) {
+      min_latitude = std::min(min_latitude, latitude);
+      max_latitude = std::max(max_latitude, latitude);
+      min_longitude = std::min(min_longitude, longitude);
+      max_longitude = std::max(max_longitude, longitude);
+    }
+  };
+
+  /// Number of points in each chunk (the last one can be smaller).
+  static constexpr Eigen::Index CHUNK_SIZE = 64;
+
+  /// Create an empty path.
+  PathGeometry();
+
+  /// Create a path from a list of GPS coordinates.
+  /** @param latitudes List of GPS latitudes of the points in the path.
+    * @param longitudes List of GPS longitudes of the points in the path. It
+    *   must have the same size as latitudes, otherwise an empty path is
+    *   created.
+    */
+  PathGeometry(const QList<double>& latitudes, const QList<double>& longitudes);
+
+  PathGeometry(const PathGeometry& other);
+  PathGeometry& operator=(const PathGeometry& other);
+  ~PathGeometry();
+
+  /// Tell if the path contains no points.
+  bool isEmpty() const;
+
+  /// Number of points in the path.
+  Eigen::Index size() const;
+
+  /// Latitudes of the points in the path.
+  const Eigen::ArrayXd& latitudes() const;
+
+  /// Longitudes of the points in the path.
+  const Eigen::ArrayXd& longitudes() const;
+
+  /// Latitudes of the points in the path, in fixed-point format.
+  /** @see math_utilities::toFixedPoint() */
+  const math_utilities::FixedPointArray& fixedLatitudes() const;
+
+  /// Longitudes of the points in the path, in fixed-point format.
+  /** @see math_utilities::toFixedPoint() */
+  const math_utilities::FixedPointArray& fixedLongitudes() const;
+
+  /// Length, in km, of each segment: the i-th is from point i to point i+1.
+  const Eigen::ArrayXd& segmentLengths() const;
+
+  /// Distance, in km, along the path from the first point to each point.
+  const Eigen::ArrayXd& arclength() const;
+
+  /// Total length of the path, in km.
+  double length() const;
+
+  /// Bounding box of the whole path.
+  const BoundingBox& bounds() const;
+
+  /// Number of chunks the path is split into.
+  Eigen::Index chunkCount() const;
+
+  /// Bounding box of the segments that start in the given chunk.
+  const BoundingBox& chunkBounds(Eigen::Index chunk) const;
+
+  /// Distance, in km, between a location and the path.
+  /** The distance is measured to the closest point of the path, which can lie
+    * anywhere along a segment, not only at a vertex. The closest point is
+    * found in the projection used by math_utilities::polylineDistance(),
+    * where chunks whose bounding box is farther than the closest point found
+    * so far are skipped; its distance is then measured with the given policy.
+    * @see math_utilities::polylineDistance()
+    * @param latitude GPS latitude of the location.
+    * @param longitude GPS longitude of the location.
+    * @param[out] segment Index of the segment that contains the closest point,
+    *   i.e., the one from point 'segment' to point 'segment+1'.
+    * @param[out] fraction Position of the closest point along the segment,
+    *   from 0 (at point 'segment') to 1 (at point 'segment+1').
+    * @return The distance, or +infinity if the path is empty.
+    * @tparam Policy One of the math_utilities::distance_policy classes.
+    */
+  template<class Policy = math_utilities::distance_policy::Equirectangular>
+  double distanceTo(
+    double latitude,
+    double longitude,
+    Eigen::Index& segment,
+    double& fraction
+  ) const;
+
+private:
+  QSharedDataPointer<PathGeometryData> d;
+};
+
+#include "path_geometry.hxx"
+
+#endif // PATH_GEOMETRY_HPP
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "path_geometry.hpp"
+
+#include <cmath>
+#include <limits>
+#include <type_traits>
+
+
+template<class Policy>
+double PathGeometry::distanceTo(
+  double latitude,
+  double longitude,
+  Eigen::Index& segment,
+  double& fraction
+) const
+{
+  segment = 0;
+  fraction = 0.0;
+  double best = std::numeric_limits<double>::infinity();
+
+  // Scale factors of the projection used by polylineDistance(): it maps boxes
+  // to boxes, so that the distance from a box is easy to bound.
+  const double ky = math_utilities::EARTH_RADIUS_KM * math_utilities::TO_RAD;
+  const double kx = ky * std::cos(math_utilities::TO_RAD * latitude);
+
+  for(Eigen::Index c=0; c<chunkCount(); c++) {
+    // Skip the chunk if no point in its box can beat the best one.
+    const BoundingBox& box = chunkBounds(c);
+    const double dlat = std::max({0.0, box.min_latitude - latitude, latitude - box.max_latitude});
+    const double dlon = std::max({0.0, box.min_longitude - longitude, longitude - box.max_longitude});
+    if(std::hypot(kx * dlon, ky * dlat) >= best) {
+      continue;
+    }
+
+    // The last chunk can be made of a single point, which is also part of
+    // the previous chunk (unless the path has a single point).
+    const Eigen::Index first = c * CHUNK_SIZE;
+    const Eigen::Index count = std::min(CHUNK_SIZE + 1, size() - first);
+    if(count < 2 && c > 0) {
+      continue;
+    }
+
+    // Look for the closest point among the segments of the chunk.
+    Eigen::Index chunk_segment;
+    double chunk_fraction;
+    const double distance = math_utilities::polylineDistance(
+      latitudes().segment(first, count),
+      longitudes().segment(first, count),
+      latitude,
+      longitude,
+      chunk_segment,
+      chunk_fraction
+    );
+    if(distance < best) {
+      best = distance;
+      segment = first + chunk_segment;
+      fraction = chunk_fraction;
+    }
+  }
+
+  // Measure the distance from the closest point with the policy, unless the
+  // projected one is enough.
+  if constexpr(std::is_same_v<Policy, math_utilities::distance_policy::Equirectangular>) {
+    return best;
+  }
+  else {
+    if(isEmpty()) {
+      return best;
+    }
+    const Eigen::Index next = std::min(segment + 1, size() - 1);
+    return Policy::distance(
+      latitudes()(segment) + fraction * (latitudes()(next) - latitudes()(segment)),
+      longitudes()(segment) + fraction * (longitudes()(next) - longitudes()(segment)),
+      latitude,
+      longitude
+    );
+  }
+}
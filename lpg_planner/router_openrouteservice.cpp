@@ -6,12 +6,11 @@
 #include <QInputDialog>
 #include <QJsonArray>
 #include <QJsonObject>
-#include <QMessageBox>
-#include <QProgressDialog>
 #include <QStandardPaths>
 
 
 const QString RouterOpenRouteService::API_KEY_FILENAME = "open_route_service_api_key";
+const QString RouterOpenRouteService::VEHICLE_PROFILE = "driving-car";
 
 
 QString RouterOpenRouteService::key() {
@@ -108,11 +107,6 @@ RouterOpenRouteService::RouterOpenRouteService(
   QObject *parent
 ) : RouterService(database, parent)
 {
-  // If the parent is a Widget, store an explicit reference to it so that it
-  // can be used as the parent for all QMessageBox dialogs.
-  // TODO: THIS SHOULD BE REMOVED IN FAVOR OF A SIGNAL/SLOT MECHANISM.
-  parent_widget_ = qobject_cast<QWidget*>(parent);
-
   // Create a new Network Manager to send HTTPS requests.
   network_manager_ = new QNetworkAccessManager(this);
 
@@ -137,19 +131,7 @@ bool RouterOpenRouteService::waitForJson(
   // Sometimes it takes a bit for the reply to be ready, so it is probably a
   // good idea to at least show the user that the app is not frozen, just
   // waiting for a reply from OpenRouteService.
-  QProgressDialog* progress_dialog = nullptr;
-  if(parent_widget_ != nullptr) {
-    progress_dialog = new QProgressDialog(
-      "Waiting for response from OpenRouteService",
-      "A request has been sent to OpenRouteService. Waiting for a reply, please wait...",
-      0,
-      0,
-      parent_widget_
-    );
-    progress_dialog->setWindowModality(Qt::ApplicationModal);
-    progress_dialog->setCancelButton(nullptr);
-    progress_dialog->show();
-  }
+  emit busy(true);
 
   // After the HTTPS request has been sent we need to wait for its response.
   // One way to wait would be to connect a slot to the QNetworkReply::finished
@@ -163,11 +145,7 @@ bool RouterOpenRouteService::waitForJson(
   QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
   loop.exec();
 
-  // Close the dialog
-  if(progress_dialog != nullptr) {
-    progress_dialog->close();
-    progress_dialog->deleteLater();
-  }
+  emit busy(false);
 
   // Allow Qt to do its magic in terms of memory management!
   reply->deleteLater();
@@ -177,7 +155,7 @@ bool RouterOpenRouteService::waitForJson(
   json = QJsonDocument::fromJson(reply->readAll(), &error);
 
   if(error.error != QJsonParseError::NoError) {
-    QMessageBox::critical(parent_widget_, "Failed to parse response", error.errorString());
+    emit this->error("Failed to parse response from OpenRouteService: " + error.errorString());
     return false;
   }
   return true;
@@ -213,7 +191,8 @@ bool RouterOpenRouteService::path(
   // See https://openrouteservice.org/dev/#/api-docs/v2/directions/{profile}/get
   QNetworkRequest request(
     QUrl(
-      QString("https://api.openrouteservice.org/v2/directions/driving-car?api_key=%1&start=%2,%3&end=%4,%5").arg(
+      QString("https://api.openrouteservice.org/v2/directions/%1?api_key=%2&start=%3,%4&end=%5,%6").arg(
+        VEHICLE_PROFILE,
         api_key_,
         QString::number(waypoints_longitudes[0], 'f', 6),
         QString::number(waypoints_latitudes[0], 'f', 6),
@@ -234,12 +213,12 @@ bool RouterOpenRouteService::path(
   QJsonArray coordinates_array = coordinates_json_value.toArray();
 
   if(coordinates_json_value.isNull() || !coordinates_json_value.isArray()) {
-    QMessageBox::critical(parent_widget_, "Failed to parse response", "Could not retrieve 'features/0/geometry/coordinates' as an array from parsed GEOJson.");
+    emit error("Failed to parse response from OpenRouteService: could not retrieve 'features/0/geometry/coordinates' as an array from parsed GEOJson.");
     return false;
   }
 
   if(coordinates_array.empty()) {
-    QMessageBox::critical(parent_widget_, "Failed to get route", "Array 'features/0/geometry/coordinates' from parsed GEOJson is empty.");
+    emit error("Failed to get route from OpenRouteService: array 'features/0/geometry/coordinates' from parsed GEOJson is empty.");
     return false;
   }
 
@@ -288,7 +267,7 @@ bool RouterOpenRouteService::distanceMatrix(
 
   // Create a request and attach a header to it.
   // See https://openrouteservice.org/dev/#/api-docs/v2/matrix/{profile}/post
-  QNetworkRequest request(QUrl("https://api.openrouteservice.org/v2/matrix/driving-car"));
+  QNetworkRequest request(QUrl("https://api.openrouteservice.org/v2/matrix/" + VEHICLE_PROFILE));
   request.setRawHeader("Accept", "application/json, application/geo+json, application/gpx+xml, img/png; charset=utf-8");
   request.setRawHeader("Authorization", api_key_.toUtf8());
   request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json; charset=utf-8");
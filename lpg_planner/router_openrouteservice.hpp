@@ -38,6 +38,16 @@ public:
     QList<QList<double>>& distances
   ) override;
 
+  /// Name of the backend and of the vehicle profile used for distances.
+  /** @return "openrouteservice/" followed by VEHICLE_PROFILE.
+    */
+  virtual QString profile() const override { return "openrouteservice/" + VEHICLE_PROFILE; }
+
+  /// Tell if path() connects the waypoints with great-circle arcs.
+  /** @return false, since paths follow the roads.
+    */
+  virtual bool hasGreatCirclePaths() const override { return false; }
+
   /// Read again the API key (usually in response to external edits).
   void reloadKey();
 
@@ -57,7 +67,7 @@ public:
 
 private:
   static const QString API_KEY_FILENAME; ///< Name of the file where to locate the API key.
-  QWidget* parent_widget_ = nullptr; ///< @todo remove it and use a signal/slot
+  static const QString VEHICLE_PROFILE; ///< Profile used for all requests, e.g., 'driving-car'.
   QString api_key_; ///< API key used to send requests to OpenRouteService.
   QNetworkAccessManager* network_manager_ = nullptr; ///< Used to send HTTPS requests.
 
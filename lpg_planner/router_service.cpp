@@ -1,6 +1,7 @@
 #include "router_service.hpp"
 
-#include <QGeoCoordinate>
+#include "great_circle_path.hpp"
+#include "math_utilities.hpp"
 
 
 RouterService::RouterService(
@@ -32,35 +33,14 @@ bool RouterService::path(
   }
 
   // The path will be created by defining small segments whose length is at
-  // most RESOLUTION_KM.
+  // most RESOLUTION_KM. Points are generated along the great-circle arcs
+  // between the waypoints, and the output lists are allocated only once.
   constexpr double RESOLUTION_KM = 5.0;
-
-  // Perform linear interpolation on consecutive waypoints.
-  for(unsigned int i=0; i<waypoints_latitudes.size()-1; i++) {
-    // Calculate the distance between a pair of consecutive waypoints.
-    double distance = 1e-3 * QGeoCoordinate(
-      {waypoints_latitudes[i], waypoints_longitudes[i]}
-    ).distanceTo(QGeoCoordinate(
-      {waypoints_latitudes[i+1], waypoints_longitudes[i+1]}
-    ));
-
-    // Evaluate how many points need to be generated in between.
-    unsigned int n_points = 1 + (unsigned int)(std::ceil(distance / RESOLUTION_KM));
-
-    // Using linear interpolation, add the intermediate points. Skip the last
-    // one (k=n_points), since it corresponds to point i+1, which will be
-    // added at the next iteration.
-    for(unsigned int k=0; k<n_points; k++) {
-      double rho = ((double)k) / n_points;
-      path_latitudes.append(waypoints_latitudes[i] * (1-rho) + waypoints_latitudes[i+1] * rho);
-      path_longitudes.append(waypoints_longitudes[i] * (1-rho) + waypoints_longitudes[i+1] * rho);
-    }
-  }
-
-  // Add the very last waypoint, since during linear interpolation we always
-  // skip the last point of the segment.
-  path_latitudes.append(waypoints_latitudes.back());
-  path_longitudes.append(waypoints_longitudes.back());
+  GreatCirclePath(waypoints_latitudes, waypoints_longitudes).sample(
+    RESOLUTION_KM,
+    path_latitudes,
+    path_longitudes
+  );
   return true;
 }
 
@@ -72,16 +52,16 @@ bool RouterService::path(
 )
 {
   // Try to fetch the coordinates from their IDs.
-  QList<double> waypoints_latitudes, waypoints_longitudes;
-  if(!database_->stationsFromIds(waypoints_ids, nullptr, &waypoints_latitudes, &waypoints_longitudes, nullptr, nullptr)) {
+  DatabaseManager::StationData waypoints;
+  if(!database_->stationsFromIds(waypoints_ids, DatabaseManager::LATITUDE | DatabaseManager::LONGITUDE, waypoints)) {
     qDebug() << "Failed to retrive coordinates from the database";
     return false;
   }
 
   // Forward the call to the other overload.
   return path(
-    waypoints_latitudes,
-    waypoints_longitudes,
+    waypoints.latitudes,
+    waypoints.longitudes,
     path_latitudes,
     path_longitudes
   );
@@ -119,12 +99,21 @@ bool RouterService::distanceMatrix(
     distances[i][i] = 0;
   }
 
-  // Fill the matrix with distances.
-  for(unsigned int i=0; i<latitudes.size()-1; i++) {
-    for(unsigned int j=i+1; j<latitudes.size(); j++) {
-      double d = 1e-3 * QGeoCoordinate({latitudes[i], longitudes[i]}).distanceTo(QGeoCoordinate({latitudes[j], longitudes[j]}));
-      distances[i][j] = d;
-      distances[j][i] = d;
+  // Fill the matrix with distances, one row at a time: the distances from
+  // point i to the following ones are calculated at once.
+  const Eigen::Index n = latitudes.size();
+  Eigen::Map<const Eigen::ArrayXd> all_latitudes(latitudes.data(), n);
+  Eigen::Map<const Eigen::ArrayXd> all_longitudes(longitudes.data(), n);
+  for(Eigen::Index i=0; i<n-1; i++) {
+    Eigen::ArrayXd row = math_utilities::geoDistance<math_utilities::distance_policy::Haversine>(
+      all_latitudes.tail(n-i-1),
+      all_longitudes.tail(n-i-1),
+      latitudes[i],
+      longitudes[i]
+    );
+    for(Eigen::Index j=i+1; j<n; j++) {
+      distances[i][j] = row(j-i-1);
+      distances[j][i] = row(j-i-1);
     }
   }
   return true;
@@ -149,32 +138,14 @@ bool RouterService::distanceMatrix(
     return true;
   }
 
-  // Resize the distance matrix, so it is ready for use.
-  distances.resize(ids.size());
-  for(unsigned int i=0; i<ids.size(); i++) {
-    distances[i].resize(ids.size());
-    distances[i][i] = 0;
-    for(unsigned int j=0; j<ids.size(); j++) {
-      distances[i][j] = i==j ? 0.0 : -1.0;
-    }
-  }
-
-  // Retrieve all existing distance pairs from the database.
-  QMap<QPair<int,int>, double> cached_distances;
-  if(!database_->distancePairs(ids, cached_distances)) {
+  // Retrieve all existing distance pairs of this profile from the database,
+  // directly into the distance matrix: missing entries are negative.
+  if(!database_->distancePairs(ids, profile(), distances)) {
     qDebug() << "Cannot calculate distance matrix: failed to fetch distance pairs from the database";
     return false;
   }
-
-  // Create an inverse map from IDs to indices.
-  QMap<int,int> idx;
   for(unsigned int i=0; i<ids.size(); i++) {
-    idx[ids[i]] = i;
-  }
-
-  // Fill the matrix with existig distances.
-  for(const auto& [p, d] : cached_distances.asKeyValueRange()) {
-    distances[idx[p.first]][idx[p.second]] = d;
+    distances[i][i] = 0;
   }
 
   // Create a list of missing distance pairs (i,j) - using the indices of the
@@ -203,18 +174,20 @@ bool RouterService::distanceMatrix(
   // Transform the set into a list and obtain the inverse map.
   QList<int> missing_list = missing_set.values();
   QList<int> missing_ids(missing_list.size());
-  idx.clear();
+  QMap<int,int> idx;
   for(unsigned int i=0; i<missing_list.size(); i++) {
     idx[missing_list[i]] = i;
     missing_ids[i] = ids[missing_list[i]];
   }
 
   // Given the missing IDs, obtain their coordinates.
-  QList<double> latitudes, longitudes;
-  if(!database_->stationsFromIds(missing_ids, nullptr, &latitudes, &longitudes, nullptr, nullptr)) {
+  DatabaseManager::StationData missing;
+  if(!database_->stationsFromIds(missing_ids, DatabaseManager::LATITUDE | DatabaseManager::LONGITUDE, missing)) {
     qDebug() << "Cannot calculate distance matrix: failed to fetch coordinates from the database";
     return false;
   }
+  const QList<double>& latitudes = missing.latitudes;
+  const QList<double>& longitudes = missing.longitudes;
 
   // Calculate the distance matrix for the missing pairs.
   QList<QList<double>> missing_distances;
@@ -224,17 +197,18 @@ bool RouterService::distanceMatrix(
   }
 
   // Copy missing values in the distance matrix and in a map.
-  cached_distances.clear();
+  QMap<QPair<int,int>, double> cached_distances;
   for(const auto& p : missing_pairs) {
     const auto& d = missing_distances[idx[p.first]][idx[p.second]];
     distances[p.first][p.second] = d;
     cached_distances[{ids[p.first], ids[p.second]}] = d;
   }
 
-  // Cache the missing values for future use.
-  if(!database_->insertPairs(cached_distances)) {
+  // Cache the missing values for future use. The distances are known by now,
+  // so failing to cache them (e.g., if the database is locked by a long
+  // import) is not an error.
+  if(!database_->insertPairs(cached_distances, profile())) {
     qDebug() << "Failed to save distance pairs into the database";
-    return false;
   }
 
   return true;
@@ -5,6 +5,7 @@
 
 #include <QList>
 #include <QObject>
+#include <QString>
 
 
 /// Base class for calculating distances between GPS coordinates.
@@ -18,10 +19,10 @@ public:
   );
 
   /// Calculate a path passing through some waypoints.
-  /** This method uses the Haversine formula and linear interpolation to
-    * calculate piece-wise linear paths. It should be overridden in sub-classes
-    * ti allow different methods of path calculations, e.g., using some service
-    * like GooGle Maps.
+  /** This method connects the waypoints with great-circle arcs (see
+    * GreatCirclePath), sampled every 5 km. It should be overridden in
+    * sub-classes ti allow different methods of path calculations, e.g., using
+    * some service like GooGle Maps.
     */
   virtual bool path(
     const QList<double>& waypoints_latitudes,
@@ -59,6 +60,34 @@ public:
     QList<QList<double>>& distances
   );
 
+  /// Name of the backend and of the vehicle profile used for distances.
+  /** Distances cached in the database are tagged with this name, and only the
+    * ones with the same name are reused: different backends (or the same
+    * backend with different vehicles) can share the database. Sub-classes
+    * that override distanceMatrix() must override this method too.
+    * @return "haversine", for straight-line distances.
+    */
+  virtual QString profile() const { return "haversine"; }
+
+  /// Tell if path() connects the waypoints with great-circle arcs.
+  /** In this case, callers can generate the points of the path by themselves
+    * with GreatCirclePath, at the resolution they need, instead of calling
+    * path(). Sub-classes that override path() must override this method too.
+    * @return true, since this class does not know about roads.
+    */
+  virtual bool hasGreatCirclePaths() const { return true; }
+
+signals:
+  /// Signal emitted when the router starts or stops waiting for a reply.
+  /** Routers can live in a thread other than the GUI one, so they never show
+    * widgets by themselves: receivers can use this signal to show that the
+    * app is not frozen, e.g., while waiting for an online service.
+    */
+  void busy(bool waiting);
+
+  /// Signal emitted when a request fails, with a message for the user.
+  void error(const QString& message);
+
 private:
   DatabaseManager* database_ = nullptr;
 };
@@ -0,0 +1,267 @@
+#include "station_index.hpp"
+
+#include "math_utilities.hpp"
+
+#include <QtDebug>
+#include <cmath>
+#include <numeric>
+#include <queue>
+
+
+StationIndex::StationIndex(
+  const QList<int>& ids,
+  const QList<double>& prices,
+  const QList<double>& latitudes,
+  const QList<double>& longitudes
+)
+{
+  if(prices.size() != ids.size() || latitudes.size() != ids.size() || longitudes.size() != ids.size()) {
+    qDebug() << "Cannot create an index from lists with different sizes";
+    return;
+  }
+
+  // Copy the stations.
+  const Eigen::Index n = ids.size();
+  ids_ = ids;
+  prices_ = Eigen::Map<const Eigen::ArrayXd>(prices.data(), n);
+  latitudes_ = math_utilities::toFixedPoint(Eigen::Map<const Eigen::ArrayXd>(latitudes.data(), n));
+  longitudes_ = math_utilities::toFixedPoint(Eigen::Map<const Eigen::ArrayXd>(longitudes.data(), n));
+  index_of_id_.reserve(n);
+  for(Eigen::Index i=0; i<n; i++) {
+    index_of_id_.insert(ids_[i], i);
+  }
+
+  if(n == 0) {
+    return;
+  }
+
+  // Build the tree, starting from all stations in the root.
+  order_.resize(n);
+  std::iota(order_.begin(), order_.end(), 0);
+  leaf_of_.resize(n);
+  build(0, n, -1, 0);
+}
+
+
+Eigen::Index StationIndex::find(
+  int id
+) const
+{
+  return index_of_id_.value(id, -1);
+}
+
+
+bool StationIndex::hasStations(
+  const QList<int>& ids,
+  const QList<double>& latitudes,
+  const QList<double>& longitudes
+) const
+{
+  if(ids != ids_ || latitudes.size() != size() || longitudes.size() != size()) {
+    return false;
+  }
+  return (math_utilities::toFixedPoint(Eigen::Map<const Eigen::ArrayXd>(latitudes.data(), size())) == latitudes_).all()
+    && (math_utilities::toFixedPoint(Eigen::Map<const Eigen::ArrayXd>(longitudes.data(), size())) == longitudes_).all();
+}
+
+
+void StationIndex::updatePrice(
+  Eigen::Index index,
+  double price
+)
+{
+  prices_(index) = price;
+
+  // Only the nodes between the station and the root can change.
+  for(int node=leaf_of_[index]; node>=0; node=nodes_[node].parent) {
+    refresh(node);
+  }
+}
+
+
+QList<StationIndex::Match> StationIndex::bestNear(
+  double latitude,
+  double longitude,
+  double radius_km,
+  int k,
+  double penalty_per_km
+) const
+{
+  QList<Match> matches;
+  if(nodes_.empty() || k <= 0) {
+    return matches;
+  }
+
+  // Entries of the queue are either nodes (with a lower bound of the score of
+  // their stations) or stations (with their actual score). A station popped
+  // from the queue is better than anything still in the queue.
+  struct Entry {
+    double score;
+    int node;
+    Eigen::Index station;
+    double distance;
+    bool operator>(const Entry& other) const { return score > other.score; }
+  };
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+
+  auto push_node = [&](int node) {
+    const double distance = distanceBound(nodes_[node].box, latitude, longitude);
+    if(distance <= radius_km) {
+      queue.push({prices_(nodes_[node].cheapest) + penalty_per_km * distance, node, -1, distance});
+    }
+  };
+  push_node(0);
+
+  while(!queue.empty() && matches.size() < k) {
+    const Entry entry = queue.top();
+    queue.pop();
+
+    // A station: this is the next best one.
+    if(entry.node < 0) {
+      const Eigen::Index i = entry.station;
+      matches.append({i, ids_[i], prices_(i), this->latitude(i), this->longitude(i), entry.distance, entry.score});
+      continue;
+    }
+
+    // A node: add its children, or its stations if it is a leaf.
+    const Node& node = nodes_[entry.node];
+    if(node.isLeaf()) {
+      for(Eigen::Index j=node.begin; j<node.end; j++) {
+        const Eigen::Index i = order_[j];
+        const double distance = math_utilities::distance_policy::Equirectangular::distance(
+          this->latitude(i),
+          this->longitude(i),
+          latitude,
+          longitude
+        );
+        if(distance <= radius_km) {
+          queue.push({prices_(i) + penalty_per_km * distance, -1, i, distance});
+        }
+      }
+    }
+    else {
+      for(int child : node.children) {
+        if(child >= 0) {
+          push_node(child);
+        }
+      }
+    }
+  }
+
+  return matches;
+}
+
+
+int StationIndex::build(
+  Eigen::Index begin,
+  Eigen::Index end,
+  int parent,
+  int depth
+)
+{
+  // Create the node; note that nodes_ can be reallocated by the recursive
+  // calls, so it is accessed by index.
+  const int node = nodes_.size();
+  nodes_.push_back(Node());
+  nodes_[node].parent = parent;
+  nodes_[node].begin = begin;
+  nodes_[node].end = end;
+  for(Eigen::Index k=begin; k<end; k++) {
+    nodes_[node].box.extend(latitudes_(order_[k]), longitudes_(order_[k]));
+  }
+
+  // Small nodes are not split any further.
+  if(end - begin <= LEAF_SIZE || depth == MAX_DEPTH) {
+    for(Eigen::Index k=begin; k<end; k++) {
+      leaf_of_[order_[k]] = node;
+    }
+    refresh(node);
+    return node;
+  }
+
+  // Split the stations into quadrants around the center of the box: first
+  // by latitude, then each half by longitude. The center is rounded up, so
+  // that both halves are non-empty along any side longer than one unit.
+  const FixedBoundingBox box = nodes_[node].box;
+  const std::int32_t mid_latitude = (std::int64_t(box.min_latitude) + box.max_latitude + 1) >> 1;
+  const std::int32_t mid_longitude = (std::int64_t(box.min_longitude) + box.max_longitude + 1) >> 1;
+  auto south = [&](Eigen::Index i) { return latitudes_(i) < mid_latitude; };
+  auto west = [&](Eigen::Index i) { return longitudes_(i) < mid_longitude; };
+  auto first = order_.begin() + begin;
+  auto last = order_.begin() + end;
+  auto split_latitude = std::partition(first, last, south);
+  auto split_south = std::partition(first, split_latitude, west);
+  auto split_north = std::partition(split_latitude, last, west);
+  const Eigen::Index bounds[5] = {
+    begin,
+    split_south - order_.begin(),
+    split_latitude - order_.begin(),
+    split_north - order_.begin(),
+    end
+  };
+
+  // Create the non-empty children.
+  for(int q=0; q<4; q++) {
+    if(bounds[q+1] > bounds[q]) {
+      int child = build(bounds[q], bounds[q+1], node, depth+1);
+      nodes_[node].children[q] = child;
+    }
+  }
+  refresh(node);
+  return node;
+}
+
+
+void StationIndex::refresh(
+  int node
+)
+{
+  Node& n = nodes_[node];
+  n.cheapest = -1;
+  auto consider = [&](Eigen::Index i) {
+    if(n.cheapest < 0 || prices_(i) < prices_(n.cheapest)) {
+      n.cheapest = i;
+    }
+  };
+
+  if(n.isLeaf()) {
+    for(Eigen::Index k=n.begin; k<n.end; k++) {
+      consider(order_[k]);
+    }
+  }
+  else {
+    for(int child : n.children) {
+      if(child >= 0) {
+        consider(nodes_[child].cheapest);
+      }
+    }
+  }
+}
+
+
+double StationIndex::distanceBound(
+  const FixedBoundingBox& box,
+  double latitude,
+  double longitude
+)
+{
+  // Sides of the box, in degrees: they are coordinates of stations, so they
+  // are the same values used to calculate the distance of the stations.
+  const double min_latitude = math_utilities::fromFixedPoint(box.min_latitude);
+  const double max_latitude = math_utilities::fromFixedPoint(box.max_latitude);
+  const double min_longitude = math_utilities::fromFixedPoint(box.min_longitude);
+  const double max_longitude = math_utilities::fromFixedPoint(box.max_longitude);
+
+  // Coordinate differences between the location and the closest side of the
+  // box (zero if the location is inside the box along that direction).
+  const double dlat = std::max({0.0, min_latitude - latitude, latitude - max_latitude});
+  const double dlon = std::max({0.0, min_longitude - longitude, longitude - max_longitude});
+
+  // The equirectangular distance scales longitudes by the cosine of the mean
+  // latitude of the two points, which is never smaller than the cosine of the
+  // largest latitude (in absolute value) involved.
+  const double largest_latitude = std::max({std::abs(latitude), std::abs(min_latitude), std::abs(max_latitude)});
+  const double x = math_utilities::TO_RAD * dlon * std::cos(math_utilities::TO_RAD * largest_latitude);
+  const double y = math_utilities::TO_RAD * dlat;
+  return math_utilities::EARTH_RADIUS_KM * std::sqrt(x * x + y * y);
+}
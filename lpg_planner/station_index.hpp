@@ -0,0 +1,247 @@
+#ifndef STATION_INDEX_HPP
+#define STATION_INDEX_HPP
+
+#include "math_utilities.hpp"
+#include "path_geometry.hpp"
+
+#include <Eigen/Dense>
+#include <QHash>
+#include <QList>
+#include <cstdint>
+#include <vector>
+
+
+/// In-memory spatial index of stations, aggregating their minimum price.
+/** Stations are stored in a quadtree: each node covers a rectangle in GPS
+  * coordinates, is split into four children at its center until it contains
+  * at most LEAF_SIZE stations, and stores which of its stations is the
+  * cheapest. Queries for the cheapest station in a region can then skip whole
+  * subtrees whose cheapest station cannot beat the best one found so far.
+  *
+  * Prices can be changed after construction with updatePrice(), which only
+  * refreshes the nodes on the path from the station to the root. Adding or
+  * removing stations, or moving them, requires building a new index.
+  *
+  * Stations are identified by their position in the lists passed to the
+  * constructor (referred to as "index" below), and can be looked up by their
+  * database ID with find().
+  *
+  * Coordinates are stored in fixed-point format (see
+  * math_utilities::toFixedPoint()), so that region queries compare integers
+  * and the coordinates take half the memory. Coordinates with at most 6
+  * decimal digits, like those in the database, are stored exactly and
+  * latitude() and longitude() give them back unchanged; other coordinates are
+  * rounded by at most 0.5e-6 degrees (about 5.6 cm along a meridian).
+  */
+class StationIndex {
+public:
+  /// Axis-aligned box in GPS coordinates.
+  using BoundingBox = PathGeometry::BoundingBox;
+
+  /// Axis-aligned box in fixed-point GPS coordinates.
+  using FixedBoundingBox = PathGeometry::FixedBoundingBox;
+
+  /// Station returned by a query, alongside its ranking.
+  struct Match {
+    Eigen::Index index = -1; ///< Index of the station.
+    int id = -1; ///< Database ID of the station.
+    double price = 0.0; ///< Fuel price at the station.
+    double latitude = 0.0; ///< GPS latitude of the station.
+    double longitude = 0.0; ///< GPS longitude of the station.
+    double distance = 0.0; ///< Distance, in km, from the query location.
+    double score = 0.0; ///< Price plus distance penalty.
+  };
+
+  /// Largest number of stations in a leaf.
+  static constexpr Eigen::Index LEAF_SIZE = 16;
+
+  /// Create an empty index.
+  StationIndex() = default;
+
+  /// Create an index for the given stations.
+  /** @param ids List of database IDs of the stations.
+    * @param prices List of fuel prices.
+    * @param latitudes List of GPS latitudes.
+    * @param longitudes List of GPS longitudes.
+    * All lists must have the same size, otherwise an empty index is created.
+    */
+  StationIndex(
+    const QList<int>& ids,
+    const QList<double>& prices,
+    const QList<double>& latitudes,
+    const QList<double>& longitudes
+  );
+
+  /// Number of stations in the index.
+  inline Eigen::Index size() const { return ids_.size(); }
+
+  /// Tell if the index contains no stations.
+  inline bool isEmpty() const { return ids_.isEmpty(); }
+
+  /// Database ID of a station.
+  inline int id(Eigen::Index index) const { return ids_[index]; }
+
+  /// Fuel price at a station.
+  inline double price(Eigen::Index index) const { return prices_(index); }
+
+  /// GPS latitude of a station.
+  inline double latitude(Eigen::Index index) const { return math_utilities::fromFixedPoint(latitudes_(index)); }
+
+  /// GPS longitude of a station.
+  inline double longitude(Eigen::Index index) const { return math_utilities::fromFixedPoint(longitudes_(index)); }
+
+  /// GPS latitude of a station, in fixed-point format.
+  inline std::int32_t fixedLatitude(Eigen::Index index) const { return latitudes_(index); }
+
+  /// GPS longitude of a station, in fixed-point format.
+  inline std::int32_t fixedLongitude(Eigen::Index index) const { return longitudes_(index); }
+
+  /// Find a station given its database ID.
+  /** @return The index of the station, or -1 if it is not in the index.
+    */
+  Eigen::Index find(int id) const;
+
+  /// Tell if the index contains exactly the given stations, in this order.
+  /** Prices are not compared: if this returns true, the index can be brought
+    * up to date with updatePrice(). Coordinates are compared after conversion
+    * to fixed-point.
+    */
+  bool hasStations(
+    const QList<int>& ids,
+    const QList<double>& latitudes,
+    const QList<double>& longitudes
+  ) const;
+
+  /// Change the price of a station.
+  /** @param index Index of the station.
+    * @param price New fuel price.
+    */
+  void updatePrice(Eigen::Index index, double price);
+
+  /// Call a function on each station in the given region.
+  /** Subtrees whose bounding box does not intersect the region are skipped.
+    * Stations are visited in no particular order.
+    * @param box Region where to look for stations.
+    * @param function Function that takes the index of a station.
+    */
+  template<class Function>
+  void forEachIn(const FixedBoundingBox& box, Function function) const;
+
+  /// Call a function on each station in the given region.
+  /** The sides of the box are rounded to the nearest fixed-point unit.
+    * @see forEachIn(const FixedBoundingBox&, Function)
+    */
+  template<class Function>
+  inline void forEachIn(const BoundingBox& box, Function function) const {
+    forEachIn(FixedBoundingBox::fromBox(box), function);
+  }
+
+  /// Find the cheapest station in the given region.
+  /** The cost of each station in the box is evaluated with the given function,
+    * which must never return less than the price of the station: this allows
+    * to prune the subtrees whose minimum price is not lower than the best
+    * cost found so far. A cost of +infinity excludes the station.
+    *
+    * Example, cheapest station taking into account a detour:
+    * ```
+    * index.cheapest(box, [&](Eigen::Index i) {
+    *   return index.price(i) * (1 + detour(i) / some_distance);
+    * });
+    * ```
+    * @param box Region where to look for stations.
+    * @param cost Function that takes the index of a station and returns its
+    *   cost.
+    * @return The index of the station with the lowest cost, or -1 if there is
+    *   no station (with finite cost) in the box.
+    */
+  template<class Cost>
+  Eigen::Index cheapest(const FixedBoundingBox& box, Cost cost) const;
+
+  /// Find the cheapest station in the given region.
+  /** The sides of the box are rounded to the nearest fixed-point unit.
+    * @see cheapest(const FixedBoundingBox&, Cost)
+    */
+  template<class Cost>
+  inline Eigen::Index cheapest(const BoundingBox& box, Cost cost) const {
+    return cheapest(FixedBoundingBox::fromBox(box), cost);
+  }
+
+  /// Find the station with the lowest price in the given region.
+  inline Eigen::Index cheapest(const FixedBoundingBox& box) const {
+    return cheapest(box, [this](Eigen::Index i) { return price(i); });
+  }
+
+  /// Find the station with the lowest price in the given region.
+  inline Eigen::Index cheapest(const BoundingBox& box) const {
+    return cheapest(FixedBoundingBox::fromBox(box));
+  }
+
+  /// Find the best-value stations near a location.
+  /** Stations are ranked by their price plus a penalty proportional to their
+    * distance from the location. The tree is explored best-first: nodes are
+    * visited in order of a lower bound of the score of their stations (their
+    * minimum price, plus the penalty for the distance of their bounding box),
+    * so that the search stops as soon as the k best stations are known.
+    *
+    * Distances use the equirectangular approximation, which is accurate for
+    * the short distances this is meant for, and for which the bound on the
+    * distance of a bounding box is exact.
+    * @param latitude GPS latitude of the location.
+    * @param longitude GPS longitude of the location.
+    * @param radius_km Stations farther than this from the location are
+    *   ignored.
+    * @param k Maximum number of stations to be returned.
+    * @param penalty_per_km Penalty added to the price for each km of distance.
+    *   It must be positive or zero.
+    * @return The (at most) k stations with the lowest score, sorted from the
+    *   best to the worst.
+    */
+  QList<Match> bestNear(
+    double latitude,
+    double longitude,
+    double radius_km,
+    int k,
+    double penalty_per_km
+  ) const;
+
+private:
+  /// Node of the quadtree.
+  struct Node {
+    FixedBoundingBox box; ///< Bounding box of the stations in the node.
+    int parent = -1; ///< Index of the parent node (-1 for the root).
+    int children[4] = {-1, -1, -1, -1}; ///< Indices of the children (-1 if missing).
+    Eigen::Index begin = 0; ///< First station of the node, in order_.
+    Eigen::Index end = 0; ///< One past the last station of the node, in order_.
+    Eigen::Index cheapest = -1; ///< Index of the cheapest station in the node.
+
+    /// Tell if the node has no children.
+    inline bool isLeaf() const { return children[0] < 0 && children[1] < 0 && children[2] < 0 && children[3] < 0; }
+  };
+
+  /// Maximum depth of the tree, reached only by (nearly) coincident stations.
+  static constexpr int MAX_DEPTH = 32;
+
+  QList<int> ids_; ///< Database IDs of the stations.
+  Eigen::ArrayXd prices_; ///< Fuel prices of the stations.
+  math_utilities::FixedPointArray latitudes_; ///< Latitudes of the stations, in fixed-point format.
+  math_utilities::FixedPointArray longitudes_; ///< Longitudes of the stations, in fixed-point format.
+  QHash<int, Eigen::Index> index_of_id_; ///< Map from database IDs to indices.
+  std::vector<Eigen::Index> order_; ///< Stations, sorted so that each node covers a contiguous range.
+  std::vector<int> leaf_of_; ///< Leaf containing each station.
+  std::vector<Node> nodes_; ///< Nodes of the tree; the root is the first one.
+
+  /// Create the subtree for the stations in order_[begin, end).
+  /** @return The index of the new node.
+    */
+  int build(Eigen::Index begin, Eigen::Index end, int parent, int depth);
+
+  /// Recalculate the cheapest station of a node from its children.
+  void refresh(int node);
+
+  /// Lower bound of the distance between a location and any point in a box.
+  static double distanceBound(const FixedBoundingBox& box, double latitude, double longitude);
+};
+
+#include "station_index.hxx"
+
+#endif // STATION_INDEX_HPP
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "station_index.hpp"
+
+#include <limits>
+#include <utility>
+
+
+template<class Function>
+void StationIndex::forEachIn(
+  const FixedBoundingBox& box,
+  Function function
+) const
+{
+  if(nodes_.empty()) {
+    return;
+  }
+
+  // Depth-first visit, using a stack of nodes to be explored.
+  std::vector<int> stack = {0};
+  while(!stack.empty()) {
+    const Node& node = nodes_[stack.back()];
+    stack.pop_back();
+
+    if(!node.box.intersects(box)) {
+      continue;
+    }
+
+    // Stations in a leaf are tested one by one.
+    if(node.isLeaf()) {
+      for(Eigen::Index k=node.begin; k<node.end; k++) {
+        const Eigen::Index i = order_[k];
+        if(box.contains(latitudes_(i), longitudes_(i))) {
+          function(i);
+        }
+      }
+      continue;
+    }
+
+    for(int child : node.children) {
+      if(child >= 0) {
+        stack.push_back(child);
+      }
+    }
+  }
+}
+
+
+template<class Cost>
+Eigen::Index StationIndex::cheapest(
+  const FixedBoundingBox& box,
+  Cost cost
+) const
+{
+  Eigen::Index best = -1;
+  double best_cost = std::numeric_limits<double>::infinity();
+  if(nodes_.empty()) {
+    return best;
+  }
+
+  // Depth-first visit, using a stack of nodes to be explored.
+  std::vector<int> stack = {0};
+  while(!stack.empty()) {
+    const Node& node = nodes_[stack.back()];
+    stack.pop_back();
+
+    // Skip the node if it is outside the region, or if no station in it can
+    // beat the best one: costs are never lower than prices.
+    if(!node.box.intersects(box) || prices_(node.cheapest) >= best_cost) {
+      continue;
+    }
+
+    // Stations in a leaf are scanned one by one.
+    if(node.isLeaf()) {
+      for(Eigen::Index k=node.begin; k<node.end; k++) {
+        const Eigen::Index i = order_[k];
+        if(prices_(i) >= best_cost || !box.contains(latitudes_(i), longitudes_(i))) {
+          continue;
+        }
+        const double c = cost(i);
+        if(c < best_cost) {
+          best = i;
+          best_cost = c;
+        }
+      }
+      continue;
+    }
+
+    // Visit the cheapest child first, so that the bound improves quickly: the
+    // last node pushed on the stack is the first one to be visited. With at
+    // most four children, insertion sort is all we need.
+    const std::size_t first = stack.size();
+    for(int child : node.children) {
+      if(child < 0) {
+        continue;
+      }
+      stack.push_back(child);
+      for(std::size_t k=stack.size()-1; k>first && prices_(nodes_[stack[k-1]].cheapest) < prices_(nodes_[stack[k]].cheapest); k--) {
+        std::swap(stack[k-1], stack[k]);
+      }
+    }
+  }
+
+  return best;
+}
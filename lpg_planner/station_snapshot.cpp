@@ -0,0 +1,245 @@
+#include "station_snapshot.hpp"
+
+#include <QSaveFile>
+#include <QtDebug>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+
+// Helper function: round an offset up to a multiple of 8 bytes.
+inline qint64 alignOffset(
+  qint64 offset
+)
+{
+  return (offset + 7) & ~qint64(7);
+}
+
+
+StationSnapshot::Layout StationSnapshot::layout(
+  qint64 size,
+  qint64 strings_size
+)
+{
+  Layout l;
+  l.ids = alignOffset(sizeof(Header));
+  l.prices = alignOffset(l.ids + size * sizeof(qint32));
+  l.latitudes = l.prices + size * sizeof(double);
+  l.longitudes = l.latitudes + size * sizeof(double);
+  l.sorted_latitudes = l.longitudes + size * sizeof(double);
+  l.by_latitude = l.sorted_latitudes + size * sizeof(double);
+  l.date_offsets = alignOffset(l.by_latitude + size * sizeof(qint32));
+  l.address_offsets = l.date_offsets + (size + 1) * sizeof(qint64);
+  l.strings = l.address_offsets + (size + 1) * sizeof(qint64);
+  l.file_size = l.strings + strings_size;
+  return l;
+}
+
+
+bool StationSnapshot::write(
+  const QString& path,
+  const QByteArray& source_id,
+  qint64 source_version,
+  const QList<int>& ids,
+  const QList<double>& prices,
+  const QList<double>& latitudes,
+  const QList<double>& longitudes,
+  const QStringList& dates,
+  const QStringList& addresses
+)
+{
+  const qint64 n = ids.size();
+  if(
+    prices.size() != n || latitudes.size() != n || longitudes.size() != n ||
+    dates.size() != n || addresses.size() != n
+  ) {
+    qDebug() << "Cannot create a snapshot from lists with different sizes";
+    return false;
+  }
+
+  // Stations are stored by increasing ID, so that they can be looked up with
+  // a binary search.
+  std::vector<qint64> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](qint64 a, qint64 b) { return ids[a] < ids[b]; });
+  for(qint64 k=1; k<n; k++) {
+    if(ids[order[k]] == ids[order[k-1]]) {
+      qDebug() << "Cannot create a snapshot with duplicate ID" << ids[order[k]];
+      return false;
+    }
+  }
+
+  // Latitude index: positions (in the snapshot) of the stations, sorted by
+  // latitude.
+  std::vector<qint32> by_latitude(n);
+  std::iota(by_latitude.begin(), by_latitude.end(), 0);
+  std::stable_sort(by_latitude.begin(), by_latitude.end(), [&](qint32 a, qint32 b) {
+    return latitudes[order[a]] < latitudes[order[b]];
+  });
+
+  // Encode the strings.
+  QByteArray strings;
+  std::vector<qint64> date_offsets, address_offsets;
+  date_offsets.reserve(n + 1);
+  address_offsets.reserve(n + 1);
+  for(auto [list, offsets] : {std::pair{&dates, &date_offsets}, std::pair{&addresses, &address_offsets}}) {
+    for(qint64 k=0; k<n; k++) {
+      offsets->push_back(strings.size());
+      strings.append((*list)[order[k]].toUtf8());
+    }
+    offsets->push_back(strings.size());
+  }
+
+  // Fill the file in memory, then write it all at once.
+  const Layout l = layout(n, strings.size());
+  QByteArray data(l.file_size, '\0');
+  Header header;
+  std::memset(&header, 0, sizeof(Header));
+  std::memcpy(header.magic, "LPGSNAP", 8);
+  header.byte_order = 0x01020304;
+  header.format_version = FORMAT_VERSION;
+  std::memcpy(header.source_id, source_id.constData(), std::min(source_id.size(), SOURCE_ID_SIZE));
+  header.source_version = source_version;
+  header.size = n;
+  header.strings_size = strings.size();
+  std::memcpy(data.data(), &header, sizeof(Header));
+
+  auto at = [&](qint64 offset, qint64 k, auto value) {
+    std::memcpy(data.data() + offset + k * sizeof(value), &value, sizeof(value));
+  };
+  for(qint64 k=0; k<n; k++) {
+    const qint64 i = order[k];
+    at(l.ids, k, qint32(ids[i]));
+    at(l.prices, k, prices[i]);
+    at(l.latitudes, k, latitudes[i]);
+    at(l.longitudes, k, longitudes[i]);
+    at(l.sorted_latitudes, k, latitudes[order[by_latitude[k]]]);
+    at(l.by_latitude, k, by_latitude[k]);
+  }
+  for(qint64 k=0; k<=n; k++) {
+    at(l.date_offsets, k, date_offsets[k]);
+    at(l.address_offsets, k, address_offsets[k]);
+  }
+  std::memcpy(data.data() + l.strings, strings.constData(), strings.size());
+
+  QSaveFile file(path);
+  if(!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+    qDebug() << "Failed to write snapshot" << path << ":" << file.errorString();
+    return false;
+  }
+  return true;
+}
+
+
+bool StationSnapshot::open(
+  const QString& path
+)
+{
+  // Release the current mapping, if any.
+  close();
+  file_.setFileName(path);
+  if(!file_.open(QIODevice::ReadOnly) || file_.size() < qint64(sizeof(Header))) {
+    return false;
+  }
+  const uchar* data = file_.map(0, file_.size());
+  if(data == nullptr) {
+    qDebug() << "Failed to map snapshot" << path << ":" << file_.errorString();
+    return false;
+  }
+
+  // Check that the file is a snapshot that we can read.
+  Header header;
+  std::memcpy(&header, data, sizeof(Header));
+  if(
+    std::memcmp(header.magic, "LPGSNAP", 8) != 0 ||
+    header.byte_order != 0x01020304 ||
+    header.format_version != FORMAT_VERSION ||
+    header.size < 0 ||
+    header.size > std::numeric_limits<qint32>::max() ||
+    header.strings_size < 0 ||
+    layout(header.size, header.strings_size).file_size != file_.size()
+  ) {
+    qDebug() << "Ignoring invalid snapshot" << path;
+    file_.unmap(const_cast<uchar*>(data));
+    file_.close();
+    return false;
+  }
+
+  // Point each array to its location in the file.
+  const Layout l = layout(header.size, header.strings_size);
+  data_ = data;
+  source_id_ = QByteArray(header.source_id, SOURCE_ID_SIZE);
+  source_version_ = header.source_version;
+  size_ = header.size;
+  ids_ = reinterpret_cast<const qint32*>(data + l.ids);
+  prices_ = reinterpret_cast<const double*>(data + l.prices);
+  latitudes_ = reinterpret_cast<const double*>(data + l.latitudes);
+  longitudes_ = reinterpret_cast<const double*>(data + l.longitudes);
+  sorted_latitudes_ = reinterpret_cast<const double*>(data + l.sorted_latitudes);
+  by_latitude_ = reinterpret_cast<const qint32*>(data + l.by_latitude);
+  date_offsets_ = reinterpret_cast<const qint64*>(data + l.date_offsets);
+  address_offsets_ = reinterpret_cast<const qint64*>(data + l.address_offsets);
+  strings_ = reinterpret_cast<const char*>(data + l.strings);
+  return true;
+}
+
+
+void StationSnapshot::close()
+{
+  if(data_ != nullptr) {
+    file_.unmap(const_cast<uchar*>(data_));
+  }
+  file_.close();
+  data_ = nullptr;
+  source_id_.clear();
+  source_version_ = 0;
+  size_ = 0;
+  ids_ = nullptr;
+  prices_ = nullptr;
+  latitudes_ = nullptr;
+  longitudes_ = nullptr;
+  sorted_latitudes_ = nullptr;
+  by_latitude_ = nullptr;
+  date_offsets_ = nullptr;
+  address_offsets_ = nullptr;
+  strings_ = nullptr;
+}
+
+
+qint64 StationSnapshot::find(
+  int id
+) const
+{
+  const qint32* it = std::lower_bound(ids_, ids_ + size_, id);
+  return (it != ids_ + size_ && *it == id) ? it - ids_ : -1;
+}
+
+
+QList<qint64> StationSnapshot::inLatitudeRange(
+  double min_latitude,
+  double max_latitude
+) const
+{
+  // Locate the range in the sorted latitudes, and collect the corresponding
+  // stations.
+  const double* first = std::lower_bound(sorted_latitudes_, sorted_latitudes_ + size_, min_latitude);
+  const double* last = std::upper_bound(first, sorted_latitudes_ + size_, max_latitude);
+  QList<qint64> indices;
+  indices.reserve(last - first);
+  for(const double* it=first; it<last; it++) {
+    indices.append(by_latitude_[it - sorted_latitudes_]);
+  }
+  std::sort(indices.begin(), indices.end());
+  return indices;
+}
+
+
+QString StationSnapshot::string(
+  const qint64* offsets,
+  qint64 index
+) const
+{
+  return QString::fromUtf8(strings_ + offsets[index], offsets[index+1] - offsets[index]);
+}
@@ -0,0 +1,174 @@
+#ifndef STATION_SNAPSHOT_HPP
+#define STATION_SNAPSHOT_HPP
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QtGlobal>
+
+
+/// Read-only copy of the Stations table, memory-mapped from a binary file.
+/** The file stores each column as a contiguous array (structure of arrays),
+  * so that once it is mapped stations can be read without any parsing:
+  *  - a header, with the number of stations, and the identity and the version
+  *    of the database the snapshot was created from;
+  *  - IDs, latitudes, longitudes and prices, sorted by ID;
+  *  - a latitude index: all latitudes in increasing order, alongside the
+  *    position of the corresponding station. This is a 1-D index: it narrows
+  *    a GPS range down to a band of latitudes, and longitudes must still be
+  *    checked for each station of the band;
+  *  - dates and addresses, as offsets into a pool of UTF-8 strings.
+  *
+  * Snapshots are created with write(), and mapped with open(). They are never
+  * modified: when the database changes, a new snapshot must be written.
+  *
+  * Stations are identified by their position in the snapshot (referred to as
+  * "index" below), and can be looked up by their database ID with find().
+  */
+class StationSnapshot {
+public:
+  /// Version of the file format, to be increased whenever it changes.
+  static constexpr quint32 FORMAT_VERSION = 3;
+
+  /// Size, in bytes, of the identity of the database stored in the header.
+  static constexpr qsizetype SOURCE_ID_SIZE = 32;
+
+  /// Create an empty snapshot.
+  StationSnapshot() = default;
+
+  /// Write a snapshot file.
+  /** The file is written to a temporary location first, and renamed once
+    * complete: readers never see a partial snapshot.
+    * @param path Path of the file.
+    * @param source_id Identity of the database the stations come from, e.g.,
+    *   a hash of its path: versions of different databases are unrelated.
+    *   It is padded with zeros (or truncated) to SOURCE_ID_SIZE bytes, and
+    *   returned by sourceId().
+    * @param source_version Version of the database the stations come from;
+    *   it is stored as is, and returned by sourceVersion().
+    * @param ids List of database IDs of the stations.
+    * @param prices List of fuel prices.
+    * @param latitudes List of GPS latitudes.
+    * @param longitudes List of GPS longitudes.
+    * @param dates List of price dates.
+    * @param addresses List of addresses.
+    * @return false if the lists have different sizes, or if the file could
+    *   not be written; true otherwise.
+    */
+  static bool write(
+    const QString& path,
+    const QByteArray& source_id,
+    qint64 source_version,
+    const QList<int>& ids,
+    const QList<double>& prices,
+    const QList<double>& latitudes,
+    const QList<double>& longitudes,
+    const QStringList& dates,
+    const QStringList& addresses
+  );
+
+  /// Map a snapshot file.
+  /** @return false if the file could not be mapped, or if it is not a valid
+    *   snapshot (e.g., if it was written with a different FORMAT_VERSION); in
+    *   this case the snapshot is left empty.
+    */
+  bool open(const QString& path);
+
+  /// Unmap the file, leaving the snapshot empty.
+  void close();
+
+  /// Tell if a snapshot file is mapped.
+  inline bool isOpen() const { return data_ != nullptr; }
+
+  /// Identity of the database the snapshot was created from.
+  /** @return SOURCE_ID_SIZE bytes, or an empty array if no file is mapped.
+    */
+  inline QByteArray sourceId() const { return source_id_; }
+
+  /// Version of the database the snapshot was created from.
+  inline qint64 sourceVersion() const { return source_version_; }
+
+  /// Number of stations in the snapshot.
+  inline qint64 size() const { return size_; }
+
+  /// Database ID of a station.
+  inline int id(qint64 index) const { return ids_[index]; }
+
+  /// Fuel price at a station.
+  inline double price(qint64 index) const { return prices_[index]; }
+
+  /// GPS latitude of a station.
+  inline double latitude(qint64 index) const { return latitudes_[index]; }
+
+  /// GPS longitude of a station.
+  inline double longitude(qint64 index) const { return longitudes_[index]; }
+
+  /// Date of the price of a station.
+  inline QString date(qint64 index) const { return string(date_offsets_, index); }
+
+  /// Address of a station.
+  inline QString address(qint64 index) const { return string(address_offsets_, index); }
+
+  /// Find a station given its database ID.
+  /** @return The index of the station, or -1 if it is not in the snapshot.
+    */
+  qint64 find(int id) const;
+
+  /// Find the stations whose latitude is in the given range.
+  /** @param min_latitude Minimum latitude (included).
+    * @param max_latitude Maximum latitude (included).
+    * @return The indices of the stations, in increasing order.
+    */
+  QList<qint64> inLatitudeRange(double min_latitude, double max_latitude) const;
+
+private:
+  /// Header of a snapshot file.
+  struct Header {
+    char magic[8]; ///< Always "LPGSNAP".
+    quint32 byte_order; ///< Always 0x01020304, written in native byte order.
+    quint32 format_version; ///< FORMAT_VERSION of the writer.
+    char source_id[SOURCE_ID_SIZE]; ///< Identity of the database.
+    qint64 source_version; ///< Version of the database.
+    qint64 size; ///< Number of stations.
+    qint64 strings_size; ///< Size, in bytes, of the pool of strings.
+  };
+
+  /// Offsets, in bytes from the start of the file, of each array.
+  struct Layout {
+    qint64 ids;
+    qint64 prices;
+    qint64 latitudes;
+    qint64 longitudes;
+    qint64 sorted_latitudes;
+    qint64 by_latitude;
+    qint64 date_offsets;
+    qint64 address_offsets;
+    qint64 strings;
+    qint64 file_size; ///< Total size of the file.
+  };
+
+  /// Compute the layout of a file, each array being aligned to 8 bytes.
+  static Layout layout(qint64 size, qint64 strings_size);
+
+  /// Decode a string from the pool.
+  QString string(const qint64* offsets, qint64 index) const;
+
+  QFile file_; ///< Mapped file.
+  const uchar* data_ = nullptr; ///< Start of the mapping.
+  QByteArray source_id_; ///< Identity of the database.
+  qint64 source_version_ = 0; ///< Version of the database.
+  qint64 size_ = 0; ///< Number of stations.
+  const qint32* ids_ = nullptr; ///< IDs, in increasing order.
+  const double* prices_ = nullptr; ///< Fuel prices.
+  const double* latitudes_ = nullptr; ///< Latitudes.
+  const double* longitudes_ = nullptr; ///< Longitudes.
+  const double* sorted_latitudes_ = nullptr; ///< Latitudes, in increasing order.
+  const qint32* by_latitude_ = nullptr; ///< Index of the station of each entry of sorted_latitudes_.
+  const qint64* date_offsets_ = nullptr; ///< Start of each date in the pool, plus the end of the last one.
+  const qint64* address_offsets_ = nullptr; ///< Start of each address in the pool, plus the end of the last one.
+  const char* strings_ = nullptr; ///< Pool of strings.
+};
+
+#endif // STATION_SNAPSHOT_HPP
@@ -28,6 +28,13 @@ import platformdirs
 import sqlite3
 from typing import Dict, List, Optional, Tuple
 
+# Number of stations written in each transaction. Between transactions, the
+# app can write to the database (e.g., to cache distances).
+STATIONS_PER_TRANSACTION = 1000
+
+# Time, in seconds, to wait for the database if it is locked by the app.
+BUSY_TIMEOUT = 30.0
+
 
 def main():
     parser = argparse.ArgumentParser(
@@ -66,7 +73,12 @@ def open_database() -> Optional[sqlite3.Connection]:
     ).joinpath("stations.db")
     if not db_path.exists() or not db_path.is_file():
         return None
-    return sqlite3.connect(db_path)
+    db_connection = sqlite3.connect(db_path, timeout=BUSY_TIMEOUT)
+    # Use the same journaling as the app: in WAL mode, the app can keep reading
+    # the database while stations are being imported.
+    db_connection.execute("PRAGMA journal_mode = WAL;")
+    db_connection.execute("PRAGMA synchronous = NORMAL;")
+    return db_connection
 
 
 def update_database(
@@ -80,7 +92,12 @@ def update_database(
     n_updated = 0
     n_ignored = 0
 
-    for station in data:
+    for i, station in enumerate(data):
+        # Commit from time to time, so that the database is not locked for the
+        # whole import.
+        if i > 0 and i % STATIONS_PER_TRANSACTION == 0:
+            db_connection.commit()
+
         # Get price and date.
         price = station["price"]
         date = station["price_date"]
@@ -143,7 +160,7 @@ def update_database(
             )
             n_updated += 1
 
-    # Apply all changes.
+    # Apply the remaining changes.
     db_connection.commit()
 
     return n_added, n_updated, n_ignored
@@ -9,7 +9,8 @@ def main():
     """Create a database for LpgPlanner.
 
     The datbase will be stored in AppData/Roaming/lpg_planner/stations.db and
-    it will contains the tables Stations and Distances.
+    it will contains the tables Stations and Distances. Distances are cached
+    separately for each router profile (e.g., "haversine").
     """
     # Make sure the target directory exists.
     db_dir = pathlib.Path(
@@ -21,6 +22,10 @@ def main():
     db_connection = sqlite3.connect(db_dir.joinpath("stations.db"))
     cursor = db_connection.cursor()
 
+    # Use WAL journaling, so that the app and the import scripts do not block
+    # each other (this setting is stored in the database).
+    cursor.execute("PRAGMA journal_mode = WAL;")
+
     # Make sure the required tables are present in the database.
     cursor.execute(
         """
@@ -38,10 +43,11 @@ def main():
     cursor.execute(
         f"""
         CREATE TABLE IF NOT EXISTS Distances(
+            profile TEXT NOT NULL DEFAULT '',
             from_id INTEGER,
             to_id INTEGER,
             distance REAL,
-            UNIQUE(from_id, to_id),
+            UNIQUE(profile, from_id, to_id),
             FOREIGN KEY(from_id) REFERENCES Stations(id),
             FOREIGN KEY(to_id) REFERENCES Stations(id)
         );
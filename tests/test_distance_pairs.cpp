@@ -0,0 +1,206 @@
+#include "database_manager.hpp"
+
+#include <QDir>
+#include <QFile>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QStandardPaths>
+#include <QTest>
+
+
+/// Tests for DatabaseManager::distancePairs().
+class TestDistancePairs : public QObject {
+  Q_OBJECT
+
+private slots:
+  /// Create a database with some cached distances, and load it.
+  void initTestCase();
+
+  /// The matrix follows the order of the IDs, with -1 for missing pairs, even
+  /// with more IDs than SQLite allows as parameters of a single query.
+  void matrix();
+
+  /// Duplicate IDs get the same rows and columns.
+  void duplicateIds();
+
+  /// IDs that are not in the database only have missing pairs.
+  void unknownIds();
+
+  /// Lists with less than two IDs give a matrix without pairs.
+  void smallLists();
+
+  /// IDs of an earlier call do not leak into the next one.
+  void repeatedCalls();
+
+private:
+  /// Number of stations in the database, with IDs from 1 to STATION_COUNT.
+  static constexpr int STATION_COUNT = 1200;
+
+  /// Distance cached for the pair, or -1 if there is none.
+  /** Pairs (k, k+1) are cached for odd values of k, for the 'haversine'
+    * profile. Pairs (k, k+1) for even values of k are cached for another
+    * profile, and must be ignored.
+    */
+  static double expected(int from_id, int to_id);
+
+  /// Check the matrix against the expected distances of the IDs.
+  static bool matches(const QList<int>& ids, const QList<QList<double>>& distances);
+};
+
+
+double TestDistancePairs::expected(
+  int from_id,
+  int to_id
+)
+{
+  if(from_id % 2 == 1 && to_id == from_id + 1 && to_id <= STATION_COUNT) {
+    return from_id + 0.5;
+  }
+  return -1.0;
+}
+
+
+bool TestDistancePairs::matches(
+  const QList<int>& ids,
+  const QList<QList<double>>& distances
+)
+{
+  if(distances.size() != ids.size()) {
+    return false;
+  }
+  for(int i=0; i<ids.size(); i++) {
+    if(distances[i].size() != ids.size()) {
+      return false;
+    }
+    for(int j=0; j<ids.size(); j++) {
+      if(distances[i][j] != expected(ids[i], ids[j])) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+
+void TestDistancePairs::initTestCase()
+{
+  // Use a directory of the test mode as "AppData", so that the database of the
+  // user is never touched.
+  QStandardPaths::setTestModeEnabled(true);
+  const QString directory = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+  QVERIFY(QDir().mkpath(directory));
+  const QString path = QDir(directory).filePath("stations.db");
+  QFile::remove(path);
+  QFile::remove(QDir(directory).filePath("stations.snapshot"));
+
+  // Create the stations, without distances.
+  {
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "setup");
+    db.setDatabaseName(path);
+    QVERIFY(db.open());
+    QSqlQuery query(db);
+    QVERIFY(query.exec(
+      "CREATE TABLE Stations("
+      "id INTEGER PRIMARY KEY AUTOINCREMENT, latitude REAL, longitude REAL,"
+      " fuel_price REAL, price_date TEXT, address TEXT,"
+      " UNIQUE(latitude, longitude));"
+    ));
+    QVERIFY(query.exec(
+      "CREATE TABLE Distances("
+      "from_id INTEGER, to_id INTEGER, distance REAL,"
+      " UNIQUE(from_id, to_id),"
+      " FOREIGN KEY(from_id) REFERENCES Stations(id),"
+      " FOREIGN KEY(to_id) REFERENCES Stations(id));"
+    ));
+    QVERIFY(query.exec(QString(
+      "WITH RECURSIVE n(k) AS (SELECT 1 UNION ALL SELECT k + 1 FROM n WHERE k < %1)"
+      " INSERT INTO Stations (id, latitude, longitude, fuel_price, price_date, address)"
+      " SELECT k, 40.0 + k / 1000.0, 9.0, 1.0, '2024-01-01', 'Station ' || k FROM n;"
+    ).arg(STATION_COUNT)));
+    db.close();
+  }
+  QSqlDatabase::removeDatabase("setup");
+
+  QCOMPARE(DatabaseManager::loadDatabase(), QString());
+
+  // Cache the distances.
+  QMap<QPair<int,int>,double> pairs, other_pairs;
+  for(int k=1; k<STATION_COUNT; k++) {
+    (k % 2 == 1 ? pairs : other_pairs).insert({k, k + 1}, k + 0.5);
+  }
+  DatabaseManager database;
+  QVERIFY(database.insertPairs(pairs, "haversine"));
+  QVERIFY(database.insertPairs(other_pairs, "driving-car"));
+}
+
+
+void TestDistancePairs::matrix()
+{
+  // Shuffle the IDs, so that the positions differ from the IDs.
+  QList<int> ids;
+  for(int k=0; k<STATION_COUNT; k++) {
+    ids.append(1 + (k * 7) % STATION_COUNT);
+  }
+
+  DatabaseManager database;
+  QList<QList<double>> distances;
+  QVERIFY(database.distancePairs(ids, "haversine", distances));
+  QVERIFY(matches(ids, distances));
+}
+
+
+void TestDistancePairs::duplicateIds()
+{
+  const QList<int> ids{2, 1, 2, 3, 1};
+  DatabaseManager database;
+  QList<QList<double>> distances;
+  QVERIFY(database.distancePairs(ids, "haversine", distances));
+  QVERIFY(matches(ids, distances));
+  QCOMPARE(distances[1][0], 1.5);
+  QCOMPARE(distances[1][2], 1.5);
+  QCOMPARE(distances[4][0], 1.5);
+  QCOMPARE(distances[4][2], 1.5);
+}
+
+
+void TestDistancePairs::unknownIds()
+{
+  const QList<int> ids{1, STATION_COUNT + 1, 2, -3};
+  DatabaseManager database;
+  QList<QList<double>> distances;
+  QVERIFY(database.distancePairs(ids, "haversine", distances));
+  QVERIFY(matches(ids, distances));
+  QCOMPARE(distances[0][2], 1.5);
+  QCOMPARE(distances[1], QList<double>(ids.size(), -1.0));
+  QCOMPARE(distances[3], QList<double>(ids.size(), -1.0));
+}
+
+
+void TestDistancePairs::smallLists()
+{
+  DatabaseManager database;
+  QList<QList<double>> distances{{1.0}};
+  QVERIFY(database.distancePairs({}, "haversine", distances));
+  QVERIFY(distances.isEmpty());
+  QVERIFY(database.distancePairs({1}, "haversine", distances));
+  QCOMPARE(distances, (QList<QList<double>>{{-1.0}}));
+}
+
+
+void TestDistancePairs::repeatedCalls()
+{
+  DatabaseManager database;
+  QList<QList<double>> distances;
+  QVERIFY(database.distancePairs({1, 2, 3, 4}, "haversine", distances));
+  QVERIFY(matches({1, 2, 3, 4}, distances));
+  QVERIFY(database.distancePairs({4, 3}, "haversine", distances));
+  QCOMPARE(distances, (QList<QList<double>>{{-1.0, -1.0}, {3.5, -1.0}}));
+  QVERIFY(database.distancePairs({4, 3}, "driving-car", distances));
+  QCOMPARE(distances, (QList<QList<double>>{{-1.0, -1.0}, {-1.0, -1.0}}));
+  QVERIFY(database.distancePairs({3, 2}, "driving-car", distances));
+  QCOMPARE(distances, (QList<QList<double>>{{-1.0, -1.0}, {2.5, -1.0}}));
+}
+
+
+QTEST_GUILESS_MAIN(TestDistancePairs)
+#include "test_distance_pairs.moc"
@@ -0,0 +1,153 @@
+#include "database_manager.hpp"
+
+#include <QDir>
+#include <QFile>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QStandardPaths>
+#include <QTest>
+
+
+/// Tests for the migration of the 'Distances' table to router profiles.
+class TestDistancesMigration : public QObject {
+  Q_OBJECT
+
+private slots:
+  /// Create a database with the old schema, and load it.
+  void initTestCase();
+
+  /// The profile column is added, and old rows are kept with the empty
+  /// profile.
+  void schema();
+
+  /// Old distances are not reused by the profiles of the routers.
+  void oldRowsNotReused();
+
+  /// The same pair can be cached separately for each profile.
+  void separateProfiles();
+};
+
+
+void TestDistancesMigration::initTestCase()
+{
+  // Use a directory of the test mode as "AppData", so that the database of the
+  // user is never touched.
+  QStandardPaths::setTestModeEnabled(true);
+  const QString directory = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+  QVERIFY(QDir().mkpath(directory));
+  const QString path = QDir(directory).filePath("stations.db");
+  QFile::remove(path);
+  QFile::remove(QDir(directory).filePath("stations.snapshot"));
+
+  // Create the tables as they were before router profiles.
+  {
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "setup");
+    db.setDatabaseName(path);
+    QVERIFY(db.open());
+    QSqlQuery query(db);
+    QVERIFY(query.exec(
+      "CREATE TABLE Stations("
+      "id INTEGER PRIMARY KEY AUTOINCREMENT, latitude REAL, longitude REAL,"
+      " fuel_price REAL, price_date TEXT, address TEXT,"
+      " UNIQUE(latitude, longitude));"
+    ));
+    QVERIFY(query.exec(
+      "CREATE TABLE Distances("
+      "from_id INTEGER, to_id INTEGER, distance REAL,"
+      " UNIQUE(from_id, to_id),"
+      " FOREIGN KEY(from_id) REFERENCES Stations(id),"
+      " FOREIGN KEY(to_id) REFERENCES Stations(id));"
+    ));
+    QVERIFY(query.exec(
+      "INSERT INTO Stations (id, latitude, longitude, fuel_price, price_date, address) VALUES"
+      " (1, 45.0, 9.0, 0.70, '2024-01-01', 'A'),"
+      " (2, 45.5, 9.5, 0.75, '2024-01-01', 'B'),"
+      " (3, 46.0, 10.0, 0.80, '2024-01-01', 'C');"
+    ));
+    QVERIFY(query.exec(
+      "INSERT INTO Distances (from_id, to_id, distance) VALUES"
+      " (1, 2, 70.0), (2, 1, 71.0), (2, 3, 72.0);"
+    ));
+    db.close();
+  }
+  QSqlDatabase::removeDatabase("setup");
+
+  QCOMPARE(DatabaseManager::loadDatabase(), QString());
+}
+
+
+void TestDistancesMigration::schema()
+{
+  QSqlDatabase db = DatabaseManager::connection();
+  const QSqlRecord record = db.record("Distances");
+  QVERIFY(record.contains("profile"));
+  QVERIFY(record.contains("from_id"));
+  QVERIFY(record.contains("to_id"));
+  QVERIFY(record.contains("distance"));
+
+  QSqlQuery query(db);
+  QVERIFY(query.exec("SELECT from_id, to_id, distance, profile FROM Distances ORDER BY from_id, to_id;"));
+  const QList<QList<QVariant>> expected{
+    {1, 2, 70.0, ""},
+    {2, 1, 71.0, ""},
+    {2, 3, 72.0, ""}
+  };
+  for(const auto& row : expected) {
+    QVERIFY(query.next());
+    QCOMPARE(query.value(0).toInt(), row[0].toInt());
+    QCOMPARE(query.value(1).toInt(), row[1].toInt());
+    QCOMPARE(query.value(2).toDouble(), row[2].toDouble());
+    QCOMPARE(query.value(3).toString(), row[3].toString());
+  }
+  QVERIFY(!query.next());
+}
+
+
+void TestDistancesMigration::oldRowsNotReused()
+{
+  DatabaseManager database;
+  QList<QList<double>> distances;
+  QVERIFY(database.distancePairs({1, 2, 3}, "haversine", distances));
+  QCOMPARE(distances.size(), 3);
+  for(const auto& row : distances) {
+    QCOMPARE(row.size(), 3);
+    for(double distance : row) {
+      QVERIFY(distance < 0.0);
+    }
+  }
+
+  // The old rows are still there, under the empty profile.
+  QVERIFY(database.distancePairs({1, 2, 3}, "", distances));
+  QCOMPARE(distances[0][1], 70.0);
+  QCOMPARE(distances[1][0], 71.0);
+  QCOMPARE(distances[1][2], 72.0);
+  QVERIFY(distances[0][2] < 0.0);
+}
+
+
+void TestDistancesMigration::separateProfiles()
+{
+  DatabaseManager database;
+  QVERIFY(database.insertPairs({{{1, 3}, 100.0}}, "haversine"));
+  QVERIFY(database.insertPairs({{{1, 3}, 120.0}}, "driving-car"));
+
+  QList<QList<double>> distances;
+  QVERIFY(database.distancePairs({1, 3}, "haversine", distances));
+  QCOMPARE(distances[0][1], 100.0);
+  QVERIFY(database.distancePairs({1, 3}, "driving-car", distances));
+  QCOMPARE(distances[0][1], 120.0);
+
+  // Updating a pair only changes the distance of its profile.
+  QVERIFY(database.insertPairs({{{1, 3}, 110.0}}, "haversine"));
+  QVERIFY(database.distancePairs({1, 3}, "haversine", distances));
+  QCOMPARE(distances[0][1], 110.0);
+  QVERIFY(database.distancePairs({1, 3}, "driving-car", distances));
+  QCOMPARE(distances[0][1], 120.0);
+  QVERIFY(database.distancePairs({1, 3}, "", distances));
+  QVERIFY(distances[0][1] < 0.0);
+}
+
+
+QTEST_GUILESS_MAIN(TestDistancesMigration)
+#include "test_distances_migration.moc"
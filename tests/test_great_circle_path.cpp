@@ -0,0 +1,145 @@
+#include "great_circle_path.hpp"
+#include "math_utilities.hpp"
+
+#include <Eigen/Dense>
+#include <QTest>
+#include <cmath>
+
+
+/// Tests for GreatCirclePath.
+class TestGreatCirclePath : public QObject {
+  Q_OBJECT
+
+private slots:
+  /// The length is the sum of the great-circle distances of the arcs.
+  void length();
+
+  /// Points lie on the arc, at the requested fraction of its length.
+  void pointOnArc();
+
+  /// Sampling keeps the waypoints, and consecutive points are not farther
+  /// apart than the resolution.
+  void sampleResolution();
+
+  /// Inconsistent or degenerate waypoints are handled.
+  void degeneratePaths();
+
+private:
+  /// Great-circle distance between two points, in km.
+  static double distance(double lat1, double lon1, double lat2, double lon2);
+};
+
+
+double TestGreatCirclePath::distance(
+  double lat1,
+  double lon1,
+  double lat2,
+  double lon2
+)
+{
+  return math_utilities::haversineDistance(
+    Eigen::Array<double, 1, 1>::Constant(lat1),
+    Eigen::Array<double, 1, 1>::Constant(lon1),
+    lat2,
+    lon2
+  )(0);
+}
+
+
+void TestGreatCirclePath::length()
+{
+  const GreatCirclePath path({45.0, 46.0, 46.5}, {9.0, 10.0, 12.0});
+  QVERIFY(path.isValid());
+  QCOMPARE(path.waypointCount(), qsizetype(3));
+  const double expected = distance(45.0, 9.0, 46.0, 10.0) + distance(46.0, 10.0, 46.5, 12.0);
+  QVERIFY(std::abs(path.length() - expected) < 1e-9);
+}
+
+
+void TestGreatCirclePath::pointOnArc()
+{
+  const GreatCirclePath path({40.0, 60.0}, {-5.0, 30.0});
+
+  // Extremities.
+  double latitude, longitude;
+  path.point(0, 0.0, latitude, longitude);
+  QVERIFY(std::abs(latitude - 40.0) < 1e-9);
+  QVERIFY(std::abs(longitude + 5.0) < 1e-9);
+  path.point(0, 1.0, latitude, longitude);
+  QVERIFY(std::abs(latitude - 60.0) < 1e-9);
+  QVERIFY(std::abs(longitude - 30.0) < 1e-9);
+
+  // Intermediate points split the arc exactly, which is not the case for
+  // linear interpolation of the coordinates on such a long arc.
+  for(double fraction : {0.1, 0.25, 0.5, 0.9}) {
+    path.point(0, fraction, latitude, longitude);
+    const double from_start = distance(40.0, -5.0, latitude, longitude);
+    const double to_end = distance(latitude, longitude, 60.0, 30.0);
+    QVERIFY(std::abs(from_start - fraction * path.length()) < 1e-6);
+    QVERIFY(std::abs(to_end - (1 - fraction) * path.length()) < 1e-6);
+  }
+}
+
+
+void TestGreatCirclePath::sampleResolution()
+{
+  const QList<double> waypoints_latitudes{45.0, 45.0, 46.0, 46.0001};
+  const QList<double> waypoints_longitudes{9.0, 11.0, 11.0, 11.0};
+  const GreatCirclePath path(waypoints_latitudes, waypoints_longitudes);
+
+  constexpr double RESOLUTION = 7.0;
+  QList<double> latitudes{1.0, 2.0}, longitudes;
+  path.sample(RESOLUTION, latitudes, longitudes);
+  QCOMPARE(latitudes.size(), path.size(RESOLUTION));
+  QCOMPARE(longitudes.size(), latitudes.size());
+
+  // Every waypoint is part of the output, in order.
+  qsizetype next = 0;
+  for(qsizetype i=0; i<latitudes.size() && next<waypoints_latitudes.size(); i++) {
+    if(latitudes[i] == waypoints_latitudes[next] && longitudes[i] == waypoints_longitudes[next]) {
+      next++;
+    }
+  }
+  QCOMPARE(next, waypoints_latitudes.size());
+
+  // Points are evenly spaced within each arc, and never too far apart.
+  double total = 0.0;
+  for(qsizetype i=1; i<latitudes.size(); i++) {
+    const double step = distance(latitudes[i-1], longitudes[i-1], latitudes[i], longitudes[i]);
+    QVERIFY(step <= RESOLUTION + 1e-9);
+    total += step;
+  }
+  QVERIFY(std::abs(total - path.length()) < 1e-6);
+}
+
+
+void TestGreatCirclePath::degeneratePaths()
+{
+  QList<double> latitudes, longitudes;
+
+  const GreatCirclePath invalid({45.0, 46.0}, {9.0});
+  QVERIFY(!invalid.isValid());
+  QCOMPARE(invalid.size(1.0), qsizetype(0));
+  invalid.sample(1.0, latitudes, longitudes);
+  QVERIFY(latitudes.isEmpty());
+  QVERIFY(longitudes.isEmpty());
+
+  const GreatCirclePath single({45.0}, {9.0});
+  QVERIFY(single.isValid());
+  QCOMPARE(single.length(), 0.0);
+  single.sample(1.0, latitudes, longitudes);
+  QCOMPARE(latitudes, QList<double>{45.0});
+  QCOMPARE(longitudes, QList<double>{9.0});
+
+  // Coincident waypoints give a single piece.
+  const GreatCirclePath still({45.0, 45.0}, {9.0, 9.0});
+  QCOMPARE(still.size(1.0), qsizetype(2));
+  double latitude, longitude;
+  still.point(0, 0.5, latitude, longitude);
+  QCOMPARE(latitude, 45.0);
+  QCOMPARE(longitude, 9.0);
+}
+
+
+QTEST_APPLESS_MAIN(TestGreatCirclePath)
+#include "test_great_circle_path.moc"
@@ -0,0 +1,118 @@
+#include "k_best_window.hpp"
+
+#include <QTest>
+#include <algorithm>
+#include <deque>
+#include <random>
+#include <vector>
+
+
+/// Tests for KBestWindow.
+class TestKBestWindow : public QObject {
+  Q_OBJECT
+
+private slots:
+  /// The example in the documentation of the class.
+  void example();
+
+  /// Empty windows, and windows with less than k elements.
+  void smallWindows();
+
+  /// Random pushes and pops, compared with sorting the whole window.
+  void matchesSorting();
+
+  /// Custom ordering, with ties broken by a second key.
+  void customOrdering();
+};
+
+
+void TestKBestWindow::example()
+{
+  KBestWindow<double> window(2);
+  window.push(3.0);
+  window.push(1.0);
+  window.push(2.0);
+  QCOMPARE(window.best(), std::vector<double>({1.0, 2.0}));
+  window.pop();
+  window.pop();
+  QCOMPARE(window.best(), std::vector<double>({2.0}));
+  QCOMPARE(window.size(), std::size_t(1));
+}
+
+
+void TestKBestWindow::smallWindows()
+{
+  KBestWindow<int> window(3);
+  QVERIFY(window.empty());
+  QVERIFY(window.best().empty());
+
+  window.push(5);
+  window.push(4);
+  QCOMPARE(window.best(), std::vector<int>({4, 5}));
+
+  window.pop();
+  window.pop();
+  QVERIFY(window.empty());
+  QVERIFY(window.best().empty());
+
+  window.push(7);
+  window.clear();
+  QVERIFY(window.empty());
+  QVERIFY(window.best().empty());
+}
+
+
+void TestKBestWindow::matchesSorting()
+{
+  std::mt19937 generator(1);
+  std::uniform_int_distribution<int> value(0, 50);
+  for(unsigned int k : {1u, 2u, 5u}) {
+    KBestWindow<int> window(k);
+    std::deque<int> reference;
+    for(int step=0; step<2000; step++) {
+      // Push more often than pop, so that the window grows and shrinks.
+      if(!reference.empty() && generator() % 5 < 2) {
+        window.pop();
+        reference.pop_front();
+      }
+      else {
+        const int v = value(generator);
+        window.push(v);
+        reference.push_back(v);
+      }
+
+      std::vector<int> expected(reference.begin(), reference.end());
+      std::sort(expected.begin(), expected.end());
+      expected.resize(std::min<std::size_t>(k, expected.size()));
+      QCOMPARE(window.size(), reference.size());
+      QCOMPARE(window.best(), expected);
+    }
+  }
+}
+
+
+void TestKBestWindow::customOrdering()
+{
+  // Elements are indices into two arrays, as in the planner: lower price
+  // first, then lower detour.
+  const std::vector<double> prices = {1.0, 0.9, 0.9, 1.1, 0.9};
+  const std::vector<double> detours = {0.0, 2.0, 1.0, 0.0, 3.0};
+  auto cheaper = [&](int a, int b) {
+    if(prices[a] != prices[b])
+      return prices[a] < prices[b];
+    return detours[a] < detours[b];
+  };
+  KBestWindow<int, decltype(cheaper)> window(2, cheaper);
+  for(int i=0; i<5; i++) {
+    window.push(i);
+  }
+  QCOMPARE(window.best(), std::vector<int>({2, 1}));
+  window.pop();
+  window.pop();
+  window.pop();
+  QCOMPARE(window.best(), std::vector<int>({4, 3}));
+}
+
+
+QTEST_APPLESS_MAIN(TestKBestWindow)
+#include "test_k_best_window.moc"
@@ -0,0 +1,273 @@
+#include "math_utilities.hpp"
+
+#include <Eigen/Dense>
+#include <QTest>
+#include <cmath>
+#include <random>
+
+
+/// Tests for simplifyPolyline() and polylineDistance().
+class TestPolyline : public QObject {
+  Q_OBJECT
+
+private slots:
+  /// Collinear vertices are all removed, except the extremities.
+  void simplifyStraightLine();
+
+  /// Every removed vertex is within the tolerance from the simplified path.
+  void simplifyWithinTolerance();
+
+  /// Long segments are split, if there are vertices to split them.
+  void simplifyMaxSpacing();
+
+  /// Paths with less than three vertices are returned as they are.
+  void simplifyShortPaths();
+
+  /// The distance is measured to the segments, not only to the vertices.
+  void distanceToSegment();
+
+  /// The distance agrees with a dense sampling of the polyline.
+  void distanceMatchesSampling();
+
+  /// Distances can be measured with any policy.
+  void distancePolicies();
+
+  /// The tolerance of the simplification can be measured with any policy.
+  void simplifyPolicies();
+
+private:
+  /// Random walk of n vertices, with steps of about step_km.
+  static void randomPath(Eigen::Index n, double step_km, unsigned int seed, Eigen::ArrayXd& latitudes, Eigen::ArrayXd& longitudes);
+};
+
+
+void TestPolyline::randomPath(
+  Eigen::Index n,
+  double step_km,
+  unsigned int seed,
+  Eigen::ArrayXd& latitudes,
+  Eigen::ArrayXd& longitudes
+)
+{
+  std::mt19937 generator(seed);
+  std::normal_distribution<double> noise(0.0, 0.3);
+  latitudes.resize(n);
+  longitudes.resize(n);
+  latitudes(0) = 45.0;
+  longitudes(0) = 9.0;
+  double heading = 0.0;
+  for(Eigen::Index i=1; i<n; i++) {
+    heading += noise(generator);
+    latitudes(i) = latitudes(i-1) + math_utilities::latitude_variation(step_km * std::cos(heading));
+    longitudes(i) = longitudes(i-1) + math_utilities::longitude_variation(step_km * std::sin(heading), latitudes(i-1));
+  }
+}
+
+
+void TestPolyline::simplifyStraightLine()
+{
+  const Eigen::ArrayXd latitudes = Eigen::ArrayXd::LinSpaced(101, 45.0, 46.0);
+  const Eigen::ArrayXd longitudes = Eigen::ArrayXd::Constant(101, 9.0);
+  const auto kept = math_utilities::simplifyPolyline(latitudes, longitudes, 0.01);
+  QCOMPARE(kept.size(), std::size_t(2));
+  QCOMPARE(kept.front(), Eigen::Index(0));
+  QCOMPARE(kept.back(), Eigen::Index(100));
+}
+
+
+void TestPolyline::simplifyWithinTolerance()
+{
+  Eigen::ArrayXd latitudes, longitudes;
+  randomPath(2000, 0.1, 1, latitudes, longitudes);
+  for(double tolerance : {0.01, 0.05, 0.5}) {
+    const auto kept = math_utilities::simplifyPolyline(latitudes, longitudes, tolerance);
+    QVERIFY(kept.size() < std::size_t(latitudes.size()));
+    QCOMPARE(kept.front(), Eigen::Index(0));
+    QCOMPARE(kept.back(), latitudes.size()-1);
+
+    Eigen::ArrayXd kept_latitudes(kept.size());
+    Eigen::ArrayXd kept_longitudes(kept.size());
+    for(std::size_t k=0; k<kept.size(); k++) {
+      QVERIFY(k == 0 || kept[k-1] < kept[k]);
+      kept_latitudes(k) = latitudes(kept[k]);
+      kept_longitudes(k) = longitudes(kept[k]);
+    }
+
+    // Projections differ slightly between the two functions: allow 1% slack.
+    for(Eigen::Index i=0; i<latitudes.size(); i++) {
+      Eigen::Index segment;
+      double fraction;
+      const double distance = math_utilities::polylineDistance(kept_latitudes, kept_longitudes, latitudes(i), longitudes(i), segment, fraction);
+      QVERIFY2(distance <= 1.01 * tolerance, qPrintable(QString("vertex %1 is %2 km away").arg(i).arg(distance)));
+    }
+  }
+}
+
+
+void TestPolyline::simplifyMaxSpacing()
+{
+  const Eigen::ArrayXd latitudes = Eigen::ArrayXd::LinSpaced(1001, 45.0, 46.0);
+  const Eigen::ArrayXd longitudes = Eigen::ArrayXd::Constant(1001, 9.0);
+  const double max_spacing = 5.0;
+  const auto kept = math_utilities::simplifyPolyline(latitudes, longitudes, 0.01, max_spacing);
+  QVERIFY(kept.size() > 2);
+  for(std::size_t k=1; k<kept.size(); k++) {
+    const double spacing = math_utilities::distance_policy::Haversine::distance(
+      latitudes(kept[k-1]),
+      longitudes(kept[k-1]),
+      latitudes(kept[k]),
+      longitudes(kept[k])
+    );
+    QVERIFY(kept[k] == kept[k-1] + 1 || spacing <= 1.01 * max_spacing);
+  }
+}
+
+
+void TestPolyline::simplifyShortPaths()
+{
+  for(Eigen::Index n : {0, 1, 2}) {
+    const Eigen::ArrayXd latitudes = Eigen::ArrayXd::LinSpaced(n, 45.0, 46.0);
+    const Eigen::ArrayXd longitudes = Eigen::ArrayXd::LinSpaced(n, 9.0, 9.5);
+    const auto kept = math_utilities::simplifyPolyline(latitudes, longitudes, 0.1);
+    QCOMPARE(kept.size(), std::size_t(n));
+  }
+}
+
+
+void TestPolyline::distanceToSegment()
+{
+  // A 20 km segment along a meridian, and a location 1 km east of its middle:
+  // both vertices are 10 km away, the segment only 1 km.
+  Eigen::ArrayXd latitudes(2);
+  latitudes << 45.0, 45.0 + math_utilities::latitude_variation(20.0);
+  Eigen::ArrayXd longitudes = Eigen::ArrayXd::Constant(2, 9.0);
+  const double latitude = 45.0 + math_utilities::latitude_variation(10.0);
+  const double longitude = 9.0 + math_utilities::longitude_variation(1.0, latitude);
+
+  Eigen::Index segment;
+  double fraction;
+  const double distance = math_utilities::polylineDistance(latitudes, longitudes, latitude, longitude, segment, fraction);
+  QVERIFY(std::abs(distance - 1.0) < 1e-3);
+  QCOMPARE(segment, Eigen::Index(0));
+  QVERIFY(std::abs(fraction - 0.5) < 1e-3);
+
+  // Beyond the end of the segment, the closest point is the last vertex.
+  const double beyond = 45.0 + math_utilities::latitude_variation(23.0);
+  const double distance_beyond = math_utilities::polylineDistance(latitudes, longitudes, beyond, 9.0, segment, fraction);
+  QVERIFY(std::abs(distance_beyond - 3.0) < 1e-3);
+  QCOMPARE(fraction, 1.0);
+
+  // A single vertex is a valid polyline.
+  const double distance_single = math_utilities::polylineDistance(latitudes.head(1), longitudes.head(1), beyond, 9.0, segment, fraction);
+  QVERIFY(std::abs(distance_single - 23.0) < 1e-2);
+  QCOMPARE(segment, Eigen::Index(0));
+  QCOMPARE(fraction, 0.0);
+}
+
+
+void TestPolyline::distanceMatchesSampling()
+{
+  Eigen::ArrayXd latitudes, longitudes;
+  randomPath(50, 2.0, 2, latitudes, longitudes);
+
+  // Sample each segment densely: the closest sample is at most half a step
+  // (5 m at most) farther than the closest point.
+  const int SAMPLES = 200;
+  std::mt19937 generator(3);
+  std::uniform_real_distribution<double> offset(-0.1, 0.1);
+  for(int t=0; t<100; t++) {
+    const Eigen::Index i = t % latitudes.size();
+    const double latitude = latitudes(i) + offset(generator);
+    const double longitude = longitudes(i) + offset(generator);
+
+    Eigen::Index segment;
+    double fraction;
+    const double distance = math_utilities::polylineDistance(latitudes, longitudes, latitude, longitude, segment, fraction);
+
+    double sampled = std::numeric_limits<double>::infinity();
+    for(Eigen::Index s=0; s+1<latitudes.size(); s++) {
+      for(int k=0; k<=SAMPLES; k++) {
+        const double rho = double(k) / SAMPLES;
+        sampled = std::min(sampled, math_utilities::distance_policy::Equirectangular::distance(
+          latitudes(s) * (1-rho) + latitudes(s+1) * rho,
+          longitudes(s) * (1-rho) + longitudes(s+1) * rho,
+          latitude,
+          longitude
+        ));
+      }
+    }
+    // The two distances use slightly different projections.
+    QVERIFY(distance <= 1.001 * sampled + 1e-6);
+    QVERIFY(sampled <= 1.001 * distance + 0.01);
+    QVERIFY(segment >= 0 && segment < latitudes.size());
+    QVERIFY(fraction >= 0.0 && fraction <= 1.0);
+  }
+}
+
+
+void TestPolyline::distancePolicies()
+{
+  using namespace math_utilities::distance_policy;
+  Eigen::ArrayXd latitudes, longitudes;
+  randomPath(50, 2.0, 4, latitudes, longitudes);
+  std::mt19937 generator(5);
+  std::uniform_real_distribution<double> offset(-0.1, 0.1);
+  for(int t=0; t<100; t++) {
+    const Eigen::Index i = t % latitudes.size();
+    const double latitude = latitudes(i) + offset(generator);
+    const double longitude = longitudes(i) + offset(generator);
+
+    // The closest point does not depend on the policy.
+    Eigen::Index segment, haversine_segment;
+    double fraction, haversine_fraction;
+    const double distance = math_utilities::polylineDistance(latitudes, longitudes, latitude, longitude, segment, fraction);
+    const double haversine = math_utilities::polylineDistance<Haversine>(latitudes, longitudes, latitude, longitude, haversine_segment, haversine_fraction);
+    QCOMPARE(haversine_segment, segment);
+    QCOMPARE(haversine_fraction, fraction);
+
+    // Its distance is the one given by the policy.
+    const double closest_latitude = latitudes(segment) + fraction * (latitudes(segment+1) - latitudes(segment));
+    const double closest_longitude = longitudes(segment) + fraction * (longitudes(segment+1) - longitudes(segment));
+    QCOMPARE(haversine, Haversine::distance(closest_latitude, closest_longitude, latitude, longitude));
+    QVERIFY(std::abs(haversine - distance) <= 1e-3 * distance + 1e-6);
+  }
+
+  // A single vertex.
+  Eigen::Index segment;
+  double fraction;
+  const double single = math_utilities::polylineDistance<Vincenty>(latitudes.head(1), longitudes.head(1), 46.0, 9.5, segment, fraction);
+  QCOMPARE(single, Vincenty::distance(latitudes(0), longitudes(0), 46.0, 9.5));
+}
+
+
+void TestPolyline::simplifyPolicies()
+{
+  using math_utilities::distance_policy::Haversine;
+  Eigen::ArrayXd latitudes, longitudes;
+  randomPath(2000, 0.1, 6, latitudes, longitudes);
+  const double tolerance = 0.05;
+  const double max_spacing = 1.0;
+  const auto kept = math_utilities::simplifyPolyline<Haversine>(latitudes, longitudes, tolerance, max_spacing);
+  QVERIFY(kept.size() < std::size_t(latitudes.size()));
+  QCOMPARE(kept.front(), Eigen::Index(0));
+  QCOMPARE(kept.back(), latitudes.size()-1);
+
+  Eigen::ArrayXd kept_latitudes(kept.size());
+  Eigen::ArrayXd kept_longitudes(kept.size());
+  for(std::size_t k=0; k<kept.size(); k++) {
+    kept_latitudes(k) = latitudes(kept[k]);
+    kept_longitudes(k) = longitudes(kept[k]);
+    const double spacing = k == 0 ? 0.0 : Haversine::distance(kept_latitudes(k-1), kept_longitudes(k-1), kept_latitudes(k), kept_longitudes(k));
+    QVERIFY(k == 0 || kept[k] == kept[k-1] + 1 || spacing <= max_spacing);
+  }
+  for(Eigen::Index i=0; i<latitudes.size(); i++) {
+    Eigen::Index segment;
+    double fraction;
+    const double distance = math_utilities::polylineDistance<Haversine>(kept_latitudes, kept_longitudes, latitudes(i), longitudes(i), segment, fraction);
+    QVERIFY2(distance <= 1.01 * tolerance, qPrintable(QString("vertex %1 is %2 km away").arg(i).arg(distance)));
+  }
+}
+
+
+QTEST_APPLESS_MAIN(TestPolyline)
+#include "test_polyline.moc"
@@ -0,0 +1,94 @@
+#include "math_utilities.hpp"
+
+#include <Eigen/Dense>
+#include <QTest>
+#include <cmath>
+#include <random>
+#include <vector>
+
+
+/// Tests for skyline().
+class TestSkyline : public QObject {
+  Q_OBJECT
+
+private slots:
+  /// Hand-written example.
+  void example();
+
+  /// Dominance requires both a strictly lower cost and penalty.
+  void ties();
+
+  /// Random inputs, compared with testing all pairs of points.
+  void matchesBruteForce();
+
+  /// Empty input.
+  void empty();
+};
+
+
+void TestSkyline::example()
+{
+  // Point 1 dominates point 0, but points 1 and 3 are too far to dominate
+  // point 2.
+  Eigen::ArrayXd positions(4), costs(4), penalties(4);
+  positions << 0.0, 1.0, 15.0, 30.0;
+  costs << 1.0, 0.9, 1.0, 0.5;
+  penalties << 2.0, 1.0, 2.0, 0.5;
+  const std::vector<bool> not_dominated = math_utilities::skyline(positions, costs, penalties, 10.0);
+  QCOMPARE(not_dominated, std::vector<bool>({false, true, true, true}));
+}
+
+
+void TestSkyline::ties()
+{
+  Eigen::ArrayXd positions(3), costs(3), penalties(3);
+  positions << 0.0, 0.0, 0.0;
+  costs << 1.0, 1.0, 0.5;
+  penalties << 1.0, 0.5, 1.0;
+  const std::vector<bool> not_dominated = math_utilities::skyline(positions, costs, penalties, 1.0);
+  QCOMPARE(not_dominated, std::vector<bool>({true, true, true}));
+}
+
+
+void TestSkyline::matchesBruteForce()
+{
+  std::mt19937 generator(1);
+  for(int t=0; t<200; t++) {
+    // Small integer ranges, so that there are many ties.
+    const Eigen::Index n = generator() % 300;
+    Eigen::ArrayXd positions(n), costs(n), penalties(n);
+    double position = 0.0;
+    for(Eigen::Index i=0; i<n; i++) {
+      position += 0.5 * (generator() % 4);
+      positions(i) = position;
+      costs(i) = 0.1 * (generator() % 10);
+      penalties(i) = 0.3 * (generator() % 10);
+    }
+    const double window = 0.5 * (generator() % 10);
+
+    const std::vector<bool> not_dominated = math_utilities::skyline(positions, costs, penalties, window);
+    QCOMPARE(not_dominated.size(), std::size_t(n));
+    for(Eigen::Index i=0; i<n; i++) {
+      bool dominated = false;
+      for(Eigen::Index j=0; j<n; j++) {
+        dominated = dominated || (
+          std::abs(positions(j) - positions(i)) <= window &&
+          costs(j) < costs(i) &&
+          penalties(j) < penalties(i)
+        );
+      }
+      QCOMPARE(bool(not_dominated[i]), !dominated);
+    }
+  }
+}
+
+
+void TestSkyline::empty()
+{
+  const Eigen::ArrayXd none(0);
+  QVERIFY(math_utilities::skyline(none, none, none, 1.0).empty());
+}
+
+
+QTEST_APPLESS_MAIN(TestSkyline)
+#include "test_skyline.moc"
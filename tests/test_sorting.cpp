@@ -0,0 +1,104 @@
+#include "math_utilities.hpp"
+
+#include <Eigen/Dense>
+#include <QList>
+#include <QTest>
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+
+/// Tests for countingArgsort() and permute().
+class TestSorting : public QObject {
+  Q_OBJECT
+
+private slots:
+  /// The ordering sorts the keys, and keeps equal keys in their order.
+  void countingArgsortIsStable();
+
+  /// Keys equal to 0 and to max_key, and empty input.
+  void countingArgsortExtremes();
+
+  /// All kinds of containers are reordered like the keys.
+  void permuteContainers();
+
+  /// Random permutations, with cycles of all lengths.
+  void permuteRandom();
+};
+
+
+void TestSorting::countingArgsortIsStable()
+{
+  std::mt19937 generator(1);
+  Eigen::ArrayXi keys(500);
+  for(Eigen::Index i=0; i<keys.size(); i++) {
+    keys(i) = generator() % 20;
+  }
+  std::vector<Eigen::Index> expected(keys.size());
+  std::iota(expected.begin(), expected.end(), 0);
+  std::stable_sort(expected.begin(), expected.end(), [&](Eigen::Index a, Eigen::Index b) { return keys(a) < keys(b); });
+  QCOMPARE(math_utilities::countingArgsort(keys, 19), expected);
+}
+
+
+void TestSorting::countingArgsortExtremes()
+{
+  Eigen::ArrayXi keys(5);
+  keys << 7, 0, 7, 3, 0;
+  QCOMPARE(math_utilities::countingArgsort(keys, 7), std::vector<Eigen::Index>({1, 4, 3, 0, 2}));
+  QVERIFY(math_utilities::countingArgsort(Eigen::ArrayXi(0), 7).empty());
+}
+
+
+void TestSorting::permuteContainers()
+{
+  Eigen::ArrayXi keys(6);
+  keys << 3, 1, 2, 0, 1, 3;
+  Eigen::ArrayXd values(6);
+  values << 0.0, 1.0, 2.0, 3.0, 4.0, 5.0;
+  std::vector<int> ints = {10, 11, 12, 13, 14, 15};
+  std::vector<bool> flags = {true, false, true, true, false, false};
+  QList<QString> names = {"a", "b", "c", "d", "e", "f"};
+
+  const auto order = math_utilities::countingArgsort(keys, 3);
+  math_utilities::permute(order, keys, values, ints, flags, names);
+
+  Eigen::ArrayXi sorted_keys(6);
+  sorted_keys << 0, 1, 1, 2, 3, 3;
+  QVERIFY((keys == sorted_keys).all());
+  Eigen::ArrayXd sorted_values(6);
+  sorted_values << 3.0, 1.0, 4.0, 2.0, 0.0, 5.0;
+  QVERIFY((values == sorted_values).all());
+  QCOMPARE(ints, std::vector<int>({13, 11, 14, 12, 10, 15}));
+  QCOMPARE(flags, std::vector<bool>({true, false, false, true, true, false}));
+  QCOMPARE(names, QList<QString>({"d", "b", "e", "c", "a", "f"}));
+}
+
+
+void TestSorting::permuteRandom()
+{
+  std::mt19937 generator(2);
+  for(int n : {0, 1, 2, 10, 1000}) {
+    std::vector<Eigen::Index> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), generator);
+
+    Eigen::ArrayXi values = Eigen::ArrayXi::LinSpaced(n, 0, n-1);
+    std::vector<bool> flags(n);
+    for(int i=0; i<n; i++) {
+      flags[i] = generator() % 2;
+    }
+    const std::vector<bool> original_flags = flags;
+
+    math_utilities::permute(order, values, flags);
+    for(int i=0; i<n; i++) {
+      QCOMPARE(values(i), int(order[i]));
+      QCOMPARE(bool(flags[i]), bool(original_flags[order[i]]));
+    }
+  }
+}
+
+
+QTEST_APPLESS_MAIN(TestSorting)
+#include "test_sorting.moc"
@@ -0,0 +1,226 @@
+#include "database_manager.hpp"
+
+#include <QDir>
+#include <QFile>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QStandardPaths>
+#include <QTest>
+#include <algorithm>
+
+
+/// Tests for the spatial index of the stations (the StationsRTree table).
+class TestSpatialIndex : public QObject {
+  Q_OBJECT
+
+private slots:
+  /// Create a database without the index, and load it without the snapshot.
+  void initTestCase();
+
+  /// The index and its triggers are created, and the index is filled.
+  void created();
+
+  /// Inserted stations are added to the index.
+  void insertTrigger();
+
+  /// Moved stations, or stations with a new ID, are updated in the index.
+  void updateTrigger();
+
+  /// Removed stations are removed from the index.
+  void deleteTrigger();
+
+  /// GPS ranges select the same stations as the exact conditions, including
+  /// the stations on the boundaries.
+  void gpsRange();
+
+  /// An index that does not have as many rows as the stations is filled
+  /// again when the database is loaded.
+  void rebuild();
+
+private:
+  /// Tell if the index has a box around each station, and nothing else.
+  static bool inSync();
+
+  /// Run a statement on the connection of the current thread.
+  static bool exec(const QString& statement);
+};
+
+
+bool TestSpatialIndex::inSync()
+{
+  // The boxes are stored as 32-bit floats, rounded outwards: they contain the
+  // station, and they are tiny.
+  QSqlQuery query(DatabaseManager::connection());
+  return query.exec(
+    "SELECT"
+    " (SELECT COUNT(*) FROM Stations),"
+    " (SELECT COUNT(*) FROM StationsRTree),"
+    " (SELECT COUNT(*) FROM Stations AS s JOIN StationsRTree AS r ON r.id = s.id"
+    "  WHERE r.min_latitude <= s.latitude AND s.latitude <= r.max_latitude"
+    "  AND r.min_longitude <= s.longitude AND s.longitude <= r.max_longitude"
+    "  AND r.max_latitude - r.min_latitude < 1e-4 AND r.max_longitude - r.min_longitude < 1e-4);"
+  ) && query.next()
+    && query.value(0).toInt() == query.value(1).toInt()
+    && query.value(0).toInt() == query.value(2).toInt();
+}
+
+
+bool TestSpatialIndex::exec(
+  const QString& statement
+)
+{
+  QSqlQuery query(DatabaseManager::connection());
+  return query.exec(statement);
+}
+
+
+void TestSpatialIndex::initTestCase()
+{
+  // Use a directory of the test mode as "AppData", so that the database of the
+  // user is never touched.
+  QStandardPaths::setTestModeEnabled(true);
+  const QString directory = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+  QVERIFY(QDir().mkpath(directory));
+  const QString path = QDir(directory).filePath("stations.db");
+  const QString snapshot_path = QDir(directory).filePath("stations.snapshot");
+  QFile::remove(path);
+  QFile::remove(snapshot_path);
+  QDir(snapshot_path).removeRecursively();
+
+  // A directory in place of the snapshot prevents it from being written, so
+  // that queries use SQL.
+  QVERIFY(QDir().mkpath(QDir(snapshot_path).filePath("blocked")));
+
+  // Create the stations on a grid of 0.1 degrees.
+  {
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "setup");
+    db.setDatabaseName(path);
+    QVERIFY(db.open());
+    QSqlQuery query(db);
+    QVERIFY(query.exec(
+      "CREATE TABLE Stations("
+      "id INTEGER PRIMARY KEY AUTOINCREMENT, latitude REAL, longitude REAL,"
+      " fuel_price REAL, price_date TEXT, address TEXT,"
+      " UNIQUE(latitude, longitude));"
+    ));
+    QVERIFY(query.exec(
+      "CREATE TABLE Distances("
+      "from_id INTEGER, to_id INTEGER, distance REAL,"
+      " UNIQUE(from_id, to_id),"
+      " FOREIGN KEY(from_id) REFERENCES Stations(id),"
+      " FOREIGN KEY(to_id) REFERENCES Stations(id));"
+    ));
+    QVERIFY(query.exec(
+      "WITH RECURSIVE n(k) AS (SELECT 0 UNION ALL SELECT k + 1 FROM n WHERE k < 99)"
+      " INSERT INTO Stations (id, latitude, longitude, fuel_price, price_date, address)"
+      " SELECT k + 1, 45.0 + (k / 10) / 10.0, 9.0 + (k % 10) / 10.0, 1.0, '2024-01-01', 'Station ' || k FROM n;"
+    ));
+    db.close();
+  }
+  QSqlDatabase::removeDatabase("setup");
+
+  QCOMPARE(DatabaseManager::loadDatabase(), QString());
+}
+
+
+void TestSpatialIndex::created()
+{
+  QVERIFY(DatabaseManager::hasSpatialIndex());
+  QSqlQuery query(DatabaseManager::connection());
+  QVERIFY(query.exec(
+    "SELECT name FROM sqlite_master WHERE tbl_name = 'Stations' AND type = 'trigger' AND name LIKE 'StationsRTree%' ORDER BY name;"
+  ));
+  QStringList triggers;
+  while(query.next()) {
+    triggers.append(query.value(0).toString());
+  }
+  QCOMPARE(triggers, (QStringList{"StationsRTreeDelete", "StationsRTreeInsert", "StationsRTreeUpdate"}));
+  QVERIFY(inSync());
+}
+
+
+void TestSpatialIndex::insertTrigger()
+{
+  QVERIFY(exec(
+    "INSERT INTO Stations (id, latitude, longitude, fuel_price, price_date, address) VALUES"
+    " (1000, 47.123456, 11.654321, 1.0, '2024-01-01', 'New');"
+  ));
+  QVERIFY(inSync());
+
+  // Stations added by an upsert, as done by the import scripts.
+  QVERIFY(exec(
+    "INSERT INTO Stations (id, latitude, longitude, fuel_price, price_date, address) VALUES"
+    " (1000, 47.123456, 11.654321, 1.1, '2024-01-02', 'New'),"
+    " (1001, 47.2, 11.7, 1.1, '2024-01-02', 'Newer')"
+    " ON CONFLICT(id) DO UPDATE SET fuel_price = excluded.fuel_price;"
+  ));
+  QVERIFY(inSync());
+}
+
+
+void TestSpatialIndex::updateTrigger()
+{
+  QVERIFY(exec("UPDATE Stations SET latitude = 48.0, longitude = 12.0 WHERE id = 1000;"));
+  QVERIFY(inSync());
+  QVERIFY(exec("UPDATE Stations SET id = 1002 WHERE id = 1001;"));
+  QVERIFY(inSync());
+
+  // Updates of other columns leave the index as it is.
+  QVERIFY(exec("UPDATE Stations SET fuel_price = 1.2;"));
+  QVERIFY(inSync());
+}
+
+
+void TestSpatialIndex::deleteTrigger()
+{
+  QVERIFY(exec("DELETE FROM Stations WHERE id IN (1000, 1002);"));
+  QVERIFY(inSync());
+  QVERIFY(exec("DELETE FROM Stations WHERE latitude > 45.85;"));
+  QVERIFY(inSync());
+
+  QSqlQuery query(DatabaseManager::connection());
+  QVERIFY(query.exec("SELECT COUNT(*) FROM StationsRTree;"));
+  QVERIFY(query.next());
+  QCOMPARE(query.value(0).toInt(), 90);
+}
+
+
+void TestSpatialIndex::gpsRange()
+{
+  // The bounds of the range are the coordinates of some stations, which are
+  // not exactly representable as 32-bit floats.
+  DatabaseManager::Filter filter;
+  QVERIFY(filter.setGPSRange(45.1, 45.3, 9.2, 9.7));
+  DatabaseManager database;
+  DatabaseManager::StationData stations;
+  QVERIFY(database.findStations(filter, DatabaseManager::ID, stations));
+
+  QSqlQuery query(DatabaseManager::connection());
+  QVERIFY(query.exec(
+    "SELECT id FROM Stations WHERE latitude BETWEEN 45.1 AND 45.3 AND longitude BETWEEN 9.2 AND 9.7 ORDER BY id;"
+  ));
+  QList<int> expected;
+  while(query.next()) {
+    expected.append(query.value(0).toInt());
+  }
+  QCOMPARE(expected.size(), qsizetype(3 * 6));
+  std::sort(stations.ids.begin(), stations.ids.end());
+  QCOMPARE(stations.ids, expected);
+}
+
+
+void TestSpatialIndex::rebuild()
+{
+  // Modify the index behind the back of the triggers.
+  QVERIFY(exec("DELETE FROM StationsRTree WHERE id <= 10;"));
+  QVERIFY(exec("INSERT INTO StationsRTree VALUES (5000, 0.0, 0.0, 0.0, 0.0);"));
+  QVERIFY(!inSync());
+
+  QCOMPARE(DatabaseManager::loadDatabase(), QString());
+  QVERIFY(DatabaseManager::hasSpatialIndex());
+  QVERIFY(inSync());
+}
+
+
+QTEST_GUILESS_MAIN(TestSpatialIndex)
+#include "test_spatial_index.moc"
@@ -0,0 +1,317 @@
+#include "station_index.hpp"
+
+#include <QList>
+#include <QTest>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <utility>
+#include <vector>
+
+
+/// Tests for StationIndex.
+class TestStationIndex : public QObject {
+  Q_OBJECT
+
+private slots:
+  void init();
+
+  /// Stations can be looked up by ID, and compared with lists.
+  void lookup();
+
+  /// Cheapest station in random boxes, compared with a linear scan.
+  void cheapest();
+
+  /// Cheapest station with a custom cost, and excluded stations.
+  void cheapestWithCost();
+
+  /// Price updates are taken into account by the following queries.
+  void updatePrice();
+
+  /// All stations in random boxes are visited exactly once.
+  void forEachIn();
+
+  /// Best-value stations near random locations, compared with sorting.
+  void bestNear();
+
+  /// Coincident stations, and an empty index.
+  void degenerate();
+
+  /// Coordinates with more than 6 decimal digits are rounded.
+  void fixedPoint();
+
+private:
+  QList<int> ids_;
+  QList<double> prices_;
+  QList<double> latitudes_;
+  QList<double> longitudes_;
+
+  /// Round a coordinate to 6 decimal digits, as in the database.
+  static double round6(double degrees);
+
+  /// Random box inside the region of the stations.
+  StationIndex::BoundingBox randomBox(std::mt19937& generator) const;
+
+  /// Cheapest station in a box, found with a linear scan.
+  Eigen::Index scanCheapest(const StationIndex::BoundingBox& box) const;
+};
+
+
+void TestStationIndex::init()
+{
+  // Enough stations for the tree to have several levels.
+  std::mt19937 generator(1);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  ids_.clear();
+  prices_.clear();
+  latitudes_.clear();
+  longitudes_.clear();
+  for(int i=0; i<5000; i++) {
+    ids_.append(3*i + 1);
+    prices_.append(0.5 + uniform(generator));
+    latitudes_.append(round6(44.0 + 2.0 * uniform(generator)));
+    longitudes_.append(round6(7.0 + 3.0 * uniform(generator)));
+  }
+}
+
+
+double TestStationIndex::round6(
+  double degrees
+)
+{
+  return std::round(degrees * 1e6) / 1e6;
+}
+
+
+StationIndex::BoundingBox TestStationIndex::randomBox(
+  std::mt19937& generator
+) const
+{
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  StationIndex::BoundingBox box;
+  box.min_latitude = round6(44.0 + 2.0 * uniform(generator));
+  box.max_latitude = round6(box.min_latitude + 0.5 * uniform(generator));
+  box.min_longitude = round6(7.0 + 3.0 * uniform(generator));
+  box.max_longitude = round6(box.min_longitude + 0.5 * uniform(generator));
+  return box;
+}
+
+
+Eigen::Index TestStationIndex::scanCheapest(
+  const StationIndex::BoundingBox& box
+) const
+{
+  Eigen::Index best = -1;
+  for(int i=0; i<ids_.size(); i++) {
+    if(box.contains(latitudes_[i], longitudes_[i]) && (best < 0 || prices_[i] < prices_[best])) {
+      best = i;
+    }
+  }
+  return best;
+}
+
+
+void TestStationIndex::lookup()
+{
+  StationIndex index(ids_, prices_, latitudes_, longitudes_);
+  QCOMPARE(index.size(), Eigen::Index(ids_.size()));
+  for(int i=0; i<ids_.size(); i+=97) {
+    QCOMPARE(index.find(ids_[i]), Eigen::Index(i));
+    QCOMPARE(index.id(i), ids_[i]);
+    QCOMPARE(index.price(i), prices_[i]);
+    QCOMPARE(index.latitude(i), latitudes_[i]);
+    QCOMPARE(index.longitude(i), longitudes_[i]);
+  }
+  QCOMPARE(index.find(0), Eigen::Index(-1));
+
+  QVERIFY(index.hasStations(ids_, latitudes_, longitudes_));
+  QList<double> moved = latitudes_;
+  moved[10] += 1e-3;
+  QVERIFY(!index.hasStations(ids_, moved, longitudes_));
+  QVERIFY(!index.hasStations(ids_.mid(1), latitudes_.mid(1), longitudes_.mid(1)));
+}
+
+
+void TestStationIndex::cheapest()
+{
+  StationIndex index(ids_, prices_, latitudes_, longitudes_);
+  std::mt19937 generator(2);
+  for(int t=0; t<500; t++) {
+    const StationIndex::BoundingBox box = randomBox(generator);
+    QCOMPARE(index.cheapest(box), scanCheapest(box));
+  }
+
+  // A box without stations.
+  StationIndex::BoundingBox far_away;
+  far_away.min_latitude = 10.0;
+  far_away.max_latitude = 11.0;
+  far_away.min_longitude = 10.0;
+  far_away.max_longitude = 11.0;
+  QCOMPARE(index.cheapest(far_away), Eigen::Index(-1));
+}
+
+
+void TestStationIndex::cheapestWithCost()
+{
+  StationIndex index(ids_, prices_, latitudes_, longitudes_);
+
+  // The cost is never lower than the price, as required. Stations with odd
+  // indices are excluded.
+  auto cost = [&](Eigen::Index i) {
+    if(i % 2 == 1) {
+      return std::numeric_limits<double>::infinity();
+    }
+    return prices_[i] * (1.0 + 0.01 * (i % 7));
+  };
+
+  std::mt19937 generator(3);
+  for(int t=0; t<500; t++) {
+    const StationIndex::BoundingBox box = randomBox(generator);
+    Eigen::Index expected = -1;
+    for(int i=0; i<ids_.size(); i++) {
+      if(box.contains(latitudes_[i], longitudes_[i]) && std::isfinite(cost(i)) && (expected < 0 || cost(i) < cost(expected))) {
+        expected = i;
+      }
+    }
+    QCOMPARE(index.cheapest(box, cost), expected);
+  }
+}
+
+
+void TestStationIndex::updatePrice()
+{
+  StationIndex index(ids_, prices_, latitudes_, longitudes_);
+  std::mt19937 generator(4);
+  std::uniform_real_distribution<double> price(0.3, 1.5);
+  for(int t=0; t<500; t++) {
+    // Both lower and raise prices, including the cheapest station of a box.
+    const StationIndex::BoundingBox box = randomBox(generator);
+    const Eigen::Index i = (t % 2 == 0 && scanCheapest(box) >= 0) ? scanCheapest(box) : Eigen::Index(generator() % ids_.size());
+    prices_[i] = price(generator);
+    index.updatePrice(i, prices_[i]);
+    QCOMPARE(index.price(i), prices_[i]);
+    QCOMPARE(index.cheapest(box), scanCheapest(box));
+  }
+}
+
+
+void TestStationIndex::forEachIn()
+{
+  StationIndex index(ids_, prices_, latitudes_, longitudes_);
+  std::mt19937 generator(5);
+  for(int t=0; t<200; t++) {
+    const StationIndex::BoundingBox box = randomBox(generator);
+    std::vector<Eigen::Index> visited;
+    index.forEachIn(box, [&](Eigen::Index i) { visited.push_back(i); });
+    std::sort(visited.begin(), visited.end());
+
+    std::vector<Eigen::Index> expected;
+    for(int i=0; i<ids_.size(); i++) {
+      if(box.contains(latitudes_[i], longitudes_[i])) {
+        expected.push_back(i);
+      }
+    }
+    QCOMPARE(visited, expected);
+  }
+}
+
+
+void TestStationIndex::bestNear()
+{
+  StationIndex index(ids_, prices_, latitudes_, longitudes_);
+  std::mt19937 generator(6);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  const double RADIUS = 20.0;
+  const int K = 5;
+  for(int t=0; t<200; t++) {
+    const double latitude = 44.0 + 2.0 * uniform(generator);
+    const double longitude = 7.0 + 3.0 * uniform(generator);
+    const double penalty_per_km = 0.05 * uniform(generator);
+    const QList<StationIndex::Match> matches = index.bestNear(latitude, longitude, RADIUS, K, penalty_per_km);
+
+    // Scores of all stations within the radius, from the best to the worst.
+    std::vector<std::pair<double, Eigen::Index>> expected;
+    for(int i=0; i<ids_.size(); i++) {
+      const double distance = math_utilities::distance_policy::Equirectangular::distance(latitudes_[i], longitudes_[i], latitude, longitude);
+      if(distance <= RADIUS) {
+        expected.push_back({prices_[i] + penalty_per_km * distance, i});
+      }
+    }
+    std::sort(expected.begin(), expected.end());
+    expected.resize(std::min<std::size_t>(K, expected.size()));
+
+    QCOMPARE(std::size_t(matches.size()), expected.size());
+    for(std::size_t k=0; k<expected.size(); k++) {
+      QCOMPARE(matches[k].index, expected[k].second);
+      QCOMPARE(matches[k].id, ids_[expected[k].second]);
+      QVERIFY(std::abs(matches[k].score - expected[k].first) < 1e-9);
+    }
+  }
+}
+
+
+void TestStationIndex::degenerate()
+{
+  // More coincident stations than fit in a leaf.
+  const int N = 3 * StationIndex::LEAF_SIZE;
+  QList<int> ids;
+  QList<double> prices, latitudes, longitudes;
+  for(int i=0; i<N; i++) {
+    ids.append(i);
+    prices.append(1.0 + 0.01 * ((7 * i) % N));
+    latitudes.append(45.0);
+    longitudes.append(9.0);
+  }
+  StationIndex index(ids, prices, latitudes, longitudes);
+  StationIndex::BoundingBox box;
+  box.extend(45.0, 9.0);
+  QCOMPARE(index.cheapest(box), Eigen::Index(0));
+  int count = 0;
+  index.forEachIn(box, [&](Eigen::Index) { count++; });
+  QCOMPARE(count, N);
+
+  // Empty index, and lists with different sizes.
+  StationIndex empty;
+  QVERIFY(empty.isEmpty());
+  QCOMPARE(empty.cheapest(box), Eigen::Index(-1));
+  count = 0;
+  empty.forEachIn(box, [&](Eigen::Index) { count++; });
+  QCOMPARE(count, 0);
+  QVERIFY(StationIndex(ids, prices.mid(1), latitudes, longitudes).isEmpty());
+}
+
+
+void TestStationIndex::fixedPoint()
+{
+  const QList<double> latitudes{45.1234564, 45.1234566, -45.12345649};
+  const QList<double> longitudes{9.0000004, -9.0000006, 179.9999996};
+  StationIndex index({1, 2, 3}, {1.0, 1.0, 1.0}, latitudes, longitudes);
+  for(int i=0; i<3; i++) {
+    QVERIFY(std::abs(index.latitude(i) - latitudes[i]) <= 0.5e-6);
+    QVERIFY(std::abs(index.longitude(i) - longitudes[i]) <= 0.5e-6);
+    QCOMPARE(index.latitude(i), round6(latitudes[i]));
+    QCOMPARE(index.longitude(i), round6(longitudes[i]));
+  }
+  QCOMPARE(index.fixedLatitude(0), 45123456);
+  QCOMPARE(index.fixedLatitude(1), 45123457);
+  QCOMPARE(index.fixedLongitude(2), 180000000);
+
+  // Coordinates are compared after rounding.
+  QVERIFY(index.hasStations({1, 2, 3}, latitudes, longitudes));
+  QVERIFY(index.hasStations({1, 2, 3}, {45.123456, 45.123457, -45.123456}, {9.0, -9.000001, 180.0}));
+
+  // Boxes can be given directly in fixed-point format.
+  StationIndex::FixedBoundingBox box;
+  box.extend(45123456, 8999999);
+  box.extend(45123457, 9000000);
+  int count = 0;
+  index.forEachIn(box, [&](Eigen::Index i) { QCOMPARE(i, Eigen::Index(0)); count++; });
+  QCOMPARE(count, 1);
+  box.extend(45123457, -9000001);
+  QCOMPARE(index.cheapest(box), Eigen::Index(0));
+}
+
+
+QTEST_APPLESS_MAIN(TestStationIndex)
+#include "test_station_index.moc"
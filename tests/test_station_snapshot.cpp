@@ -0,0 +1,342 @@
+#include "database_manager.hpp"
+#include "station_snapshot.hpp"
+
+#include <QDir>
+#include <QFile>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QStandardPaths>
+#include <QTest>
+#include <cstring>
+
+
+/// Tests for StationSnapshot, and for its use by DatabaseManager.
+class TestStationSnapshot : public QObject {
+  Q_OBJECT
+
+private slots:
+  /// Use a directory of the test mode for all files.
+  void initTestCase();
+
+  /// Stations can be read back from a snapshot, sorted by ID.
+  void roundTrip();
+
+  /// Snapshots without stations are valid.
+  void emptySnapshot();
+
+  /// Inconsistent stations are not written.
+  void invalidStations();
+
+  /// Files of the wrong size are rejected.
+  void wrongSize();
+
+  /// Files written with another format version are rejected.
+  void wrongFormatVersion();
+
+  /// The snapshot of another database is replaced when the database is
+  /// loaded.
+  void rebuildOnLoad();
+
+  /// Once the stations are modified, queries use SQL until the version
+  /// settles, and then the snapshot is written again.
+  void invalidation();
+
+private:
+  /// Directory of the files.
+  QString directory_;
+
+  /// Write a snapshot of a few stations.
+  bool writeStations(const QString& path);
+
+  /// Check the stations written by writeStations().
+  static bool checkStations(const StationSnapshot& snapshot);
+
+  /// Read a file.
+  static QByteArray readFile(const QString& path);
+
+  /// Replace the content of a file.
+  static bool writeFile(const QString& path, const QByteArray& data);
+};
+
+
+bool TestStationSnapshot::writeStations(
+  const QString& path
+)
+{
+  return StationSnapshot::write(
+    path,
+    "source",
+    42,
+    {30, 10, 20},
+    {0.80, 0.70, 0.75},
+    {46.0, 45.0, 45.5},
+    {10.0, 9.0, 9.5},
+    {"2024-01-03", "2024-01-01", ""},
+    {"C", "A", "Via Roma, 1 - Città"}
+  );
+}
+
+
+bool TestStationSnapshot::checkStations(
+  const StationSnapshot& snapshot
+)
+{
+  return snapshot.isOpen()
+    && snapshot.size() == 3
+    && snapshot.id(0) == 10 && snapshot.id(1) == 20 && snapshot.id(2) == 30
+    && snapshot.price(0) == 0.70 && snapshot.price(1) == 0.75 && snapshot.price(2) == 0.80
+    && snapshot.latitude(0) == 45.0 && snapshot.latitude(1) == 45.5 && snapshot.latitude(2) == 46.0
+    && snapshot.longitude(0) == 9.0 && snapshot.longitude(1) == 9.5 && snapshot.longitude(2) == 10.0
+    && snapshot.date(0) == "2024-01-01" && snapshot.date(1) == "" && snapshot.date(2) == "2024-01-03"
+    && snapshot.address(0) == "A" && snapshot.address(1) == "Via Roma, 1 - Città" && snapshot.address(2) == "C";
+}
+
+
+QByteArray TestStationSnapshot::readFile(
+  const QString& path
+)
+{
+  QFile file(path);
+  if(!file.open(QIODevice::ReadOnly)) {
+    return QByteArray();
+  }
+  return file.readAll();
+}
+
+
+bool TestStationSnapshot::writeFile(
+  const QString& path,
+  const QByteArray& data
+)
+{
+  QFile file(path);
+  return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+
+void TestStationSnapshot::initTestCase()
+{
+  // Use a directory of the test mode as "AppData", so that the database of the
+  // user is never touched.
+  QStandardPaths::setTestModeEnabled(true);
+  directory_ = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+  QVERIFY(QDir().mkpath(directory_));
+}
+
+
+void TestStationSnapshot::roundTrip()
+{
+  const QString path = QDir(directory_).filePath("round_trip.snapshot");
+  QVERIFY(writeStations(path));
+
+  StationSnapshot snapshot;
+  QVERIFY(snapshot.open(path));
+  QVERIFY(checkStations(snapshot));
+
+  // The identity of the source is padded with zeros.
+  QCOMPARE(snapshot.sourceId(), QByteArray("source") + QByteArray(StationSnapshot::SOURCE_ID_SIZE - 6, '\0'));
+  QCOMPARE(snapshot.sourceVersion(), qint64(42));
+
+  QCOMPARE(snapshot.find(20), qint64(1));
+  QCOMPARE(snapshot.find(15), qint64(-1));
+  QCOMPARE(snapshot.find(40), qint64(-1));
+  QCOMPARE(snapshot.inLatitudeRange(45.5, 46.0), (QList<qint64>{1, 2}));
+  QCOMPARE(snapshot.inLatitudeRange(44.0, 45.2), (QList<qint64>{0}));
+  QVERIFY(snapshot.inLatitudeRange(46.1, 47.0).isEmpty());
+
+  // Identities longer than SOURCE_ID_SIZE are truncated.
+  const QByteArray long_id(StationSnapshot::SOURCE_ID_SIZE + 8, 'x');
+  QVERIFY(StationSnapshot::write(path, long_id, -1, {1}, {1.0}, {45.0}, {9.0}, {""}, {""}));
+  QVERIFY(snapshot.open(path));
+  QCOMPARE(snapshot.sourceId(), long_id.left(StationSnapshot::SOURCE_ID_SIZE));
+  QCOMPARE(snapshot.sourceVersion(), qint64(-1));
+
+  snapshot.close();
+  QVERIFY(!snapshot.isOpen());
+  QCOMPARE(snapshot.size(), qint64(0));
+  QVERIFY(snapshot.sourceId().isEmpty());
+}
+
+
+void TestStationSnapshot::emptySnapshot()
+{
+  const QString path = QDir(directory_).filePath("empty.snapshot");
+  QVERIFY(StationSnapshot::write(path, "source", 1, {}, {}, {}, {}, {}, {}));
+
+  StationSnapshot snapshot;
+  QVERIFY(snapshot.open(path));
+  QCOMPARE(snapshot.size(), qint64(0));
+  QCOMPARE(snapshot.find(1), qint64(-1));
+  QVERIFY(snapshot.inLatitudeRange(-90.0, 90.0).isEmpty());
+}
+
+
+void TestStationSnapshot::invalidStations()
+{
+  const QString path = QDir(directory_).filePath("invalid.snapshot");
+  QFile::remove(path);
+
+  // Lists of different sizes.
+  QVERIFY(!StationSnapshot::write(path, "source", 1, {1, 2}, {1.0}, {45.0, 46.0}, {9.0, 9.0}, {"", ""}, {"", ""}));
+
+  // Duplicate IDs.
+  QVERIFY(!StationSnapshot::write(path, "source", 1, {1, 1}, {1.0, 1.0}, {45.0, 46.0}, {9.0, 9.0}, {"", ""}, {"", ""}));
+
+  QVERIFY(!QFile::exists(path));
+}
+
+
+void TestStationSnapshot::wrongSize()
+{
+  const QString path = QDir(directory_).filePath("wrong_size.snapshot");
+  QVERIFY(writeStations(path));
+  const QByteArray data = readFile(path);
+  QVERIFY(!data.isEmpty());
+
+  StationSnapshot snapshot;
+  for(const QByteArray& modified : {data.left(data.size() - 1), data.left(16), QByteArray(data).append('\0')}) {
+    QVERIFY(writeFile(path, modified));
+    QVERIFY(!snapshot.open(path));
+    QVERIFY(!snapshot.isOpen());
+    QCOMPARE(snapshot.size(), qint64(0));
+  }
+
+  // A snapshot that fails to open leaves the snapshot empty, even if another
+  // file was mapped before.
+  QVERIFY(writeStations(path));
+  QVERIFY(snapshot.open(path));
+  QVERIFY(!snapshot.open(QDir(directory_).filePath("missing.snapshot")));
+  QVERIFY(!snapshot.isOpen());
+  QCOMPARE(snapshot.size(), qint64(0));
+}
+
+
+void TestStationSnapshot::wrongFormatVersion()
+{
+  const QString path = QDir(directory_).filePath("wrong_version.snapshot");
+  QVERIFY(writeStations(path));
+  QByteArray data = readFile(path);
+
+  // The format version follows the magic string and the byte order mark.
+  constexpr int FORMAT_VERSION_OFFSET = 12;
+  quint32 version;
+  std::memcpy(&version, data.constData() + FORMAT_VERSION_OFFSET, sizeof(version));
+  QCOMPARE(version, StationSnapshot::FORMAT_VERSION);
+  version++;
+  std::memcpy(data.data() + FORMAT_VERSION_OFFSET, &version, sizeof(version));
+  QVERIFY(writeFile(path, data));
+
+  StationSnapshot snapshot;
+  QVERIFY(!snapshot.open(path));
+  QVERIFY(!snapshot.isOpen());
+}
+
+
+void TestStationSnapshot::rebuildOnLoad()
+{
+  const QString path = QDir(directory_).filePath("stations.db");
+  const QString snapshot_path = QDir(directory_).filePath("stations.snapshot");
+  QFile::remove(path);
+  QFile::remove(snapshot_path);
+
+  // Create the stations.
+  {
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "setup");
+    db.setDatabaseName(path);
+    QVERIFY(db.open());
+    QSqlQuery query(db);
+    QVERIFY(query.exec(
+      "CREATE TABLE Stations("
+      "id INTEGER PRIMARY KEY AUTOINCREMENT, latitude REAL, longitude REAL,"
+      " fuel_price REAL, price_date TEXT, address TEXT,"
+      " UNIQUE(latitude, longitude));"
+    ));
+    QVERIFY(query.exec(
+      "CREATE TABLE Distances("
+      "from_id INTEGER, to_id INTEGER, distance REAL,"
+      " UNIQUE(from_id, to_id),"
+      " FOREIGN KEY(from_id) REFERENCES Stations(id),"
+      " FOREIGN KEY(to_id) REFERENCES Stations(id));"
+    ));
+    QVERIFY(query.exec(
+      "INSERT INTO Stations (id, latitude, longitude, fuel_price, price_date, address) VALUES"
+      " (1, 45.0, 9.0, 0.70, '2024-01-01', 'A'),"
+      " (2, 45.5, 9.5, 0.75, '2024-01-01', 'B'),"
+      " (3, 46.0, 10.0, 0.80, '2024-01-01', 'C');"
+    ));
+    db.close();
+  }
+  QSqlDatabase::removeDatabase("setup");
+
+  // A snapshot of another database, with the version this one will have.
+  QVERIFY(writeStations(snapshot_path));
+
+  QCOMPARE(DatabaseManager::loadDatabase(), QString());
+  qint64 version;
+  QVERIFY(DatabaseManager::dataVersion(version));
+
+  StationSnapshot snapshot;
+  QVERIFY(snapshot.open(snapshot_path));
+  QVERIFY(snapshot.sourceId() != StationSnapshot().sourceId());
+  QVERIFY(!snapshot.sourceId().startsWith("source"));
+  QCOMPARE(snapshot.sourceVersion(), version);
+  QCOMPARE(snapshot.size(), qint64(3));
+  QCOMPARE(snapshot.address(2), QString("C"));
+
+  // Queries read the stations of the database.
+  DatabaseManager database;
+  DatabaseManager::StationData stations;
+  QVERIFY(database.stationsFromIds({3, 1}, DatabaseManager::ADDRESS, stations));
+  QCOMPARE(stations.addresses, (QStringList{"C", "A"}));
+}
+
+
+void TestStationSnapshot::invalidation()
+{
+  const QString snapshot_path = QDir(directory_).filePath("stations.snapshot");
+  qint64 old_version;
+  QVERIFY(DatabaseManager::dataVersion(old_version));
+
+  // Modify the stations, as the import scripts would.
+  {
+    QSqlQuery query(DatabaseManager::connection());
+    QVERIFY(query.exec("UPDATE Stations SET fuel_price = 0.65, address = 'A2' WHERE id = 1;"));
+    QVERIFY(query.exec(
+      "INSERT INTO Stations (id, latitude, longitude, fuel_price, price_date, address) VALUES"
+      " (4, 46.5, 10.5, 0.85, '2024-01-02', 'D');"
+    ));
+  }
+  qint64 version;
+  QVERIFY(DatabaseManager::dataVersion(version));
+  QVERIFY(version != old_version);
+
+  // Queries see the changes right away, through SQL: the snapshot is left as
+  // it is until the version settles.
+  DatabaseManager database;
+  DatabaseManager::StationData stations;
+  const QList<int> ids{4, 1};
+  QVERIFY(database.stationsFromIds(ids, DatabaseManager::PRICE | DatabaseManager::ADDRESS, stations));
+  QCOMPARE(stations.prices, (QList<double>{0.85, 0.65}));
+  QCOMPARE(stations.addresses, (QStringList{"D", "A2"}));
+  {
+    StationSnapshot snapshot;
+    QVERIFY(snapshot.open(snapshot_path));
+    QCOMPARE(snapshot.sourceVersion(), old_version);
+  }
+
+  // Once it has settled, the snapshot is written again.
+  QTest::qSleep(DatabaseManager::SNAPSHOT_SETTLE_TIME_MS + 100);
+  QVERIFY(database.stationsFromIds(ids, DatabaseManager::PRICE | DatabaseManager::ADDRESS, stations));
+  QCOMPARE(stations.prices, (QList<double>{0.85, 0.65}));
+  QCOMPARE(stations.addresses, (QStringList{"D", "A2"}));
+  StationSnapshot snapshot;
+  QVERIFY(snapshot.open(snapshot_path));
+  QCOMPARE(snapshot.sourceVersion(), version);
+  QCOMPARE(snapshot.size(), qint64(4));
+  QCOMPARE(snapshot.price(0), 0.65);
+  QCOMPARE(snapshot.address(3), QString("D"));
+}
+
+
+QTEST_GUILESS_MAIN(TestStationSnapshot)
+#include "test_station_snapshot.moc"
@@ -0,0 +1,193 @@
+#include "database_manager.hpp"
+
+#include <QDir>
+#include <QFile>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QStandardPaths>
+#include <QTest>
+
+
+/// Tests for DatabaseManager::stationsFromIds(), when stations are read with
+/// SQL.
+class TestStationsFromIds : public QObject {
+  Q_OBJECT
+
+private slots:
+  /// Create a database with more stations than IDS_PER_QUERY, and load it
+  /// without the snapshot.
+  void initTestCase();
+
+  /// Lists spanning several chunks follow the order of the input IDs.
+  void manyIds();
+
+  /// Duplicate IDs are copied at all of their positions, even when they are
+  /// in different chunks.
+  void duplicateIds();
+
+  /// Only the requested columns are filled.
+  void selectedColumns();
+
+  /// A missing ID makes the lookup fail, and clears the output.
+  void missingId();
+
+private:
+  /// Number of stations in the database, with IDs from 1 to STATION_COUNT.
+  static constexpr int STATION_COUNT = 3 * DatabaseManager::IDS_PER_QUERY + 100;
+
+  /// Check the columns of the stations against the values they were created with.
+  static bool matches(const QList<int>& ids, const DatabaseManager::StationData& stations);
+};
+
+
+bool TestStationsFromIds::matches(
+  const QList<int>& ids,
+  const DatabaseManager::StationData& stations
+)
+{
+  if(
+    stations.prices.size() != ids.size() ||
+    stations.latitudes.size() != ids.size() ||
+    stations.longitudes.size() != ids.size() ||
+    stations.dates.size() != ids.size() ||
+    stations.addresses.size() != ids.size()
+  ) {
+    return false;
+  }
+  for(int i=0; i<ids.size(); i++) {
+    if(
+      stations.prices[i] != 1.0 + ids[i] / 10000.0 ||
+      stations.latitudes[i] != 40.0 + ids[i] / 1000.0 ||
+      stations.longitudes[i] != 9.0 - ids[i] / 1000.0 ||
+      stations.dates[i] != "2024-01-01" ||
+      stations.addresses[i] != QString("Station %1").arg(ids[i])
+    ) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+void TestStationsFromIds::initTestCase()
+{
+  // Use a directory of the test mode as "AppData", so that the database of the
+  // user is never touched.
+  QStandardPaths::setTestModeEnabled(true);
+  const QString directory = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+  QVERIFY(QDir().mkpath(directory));
+  const QString path = QDir(directory).filePath("stations.db");
+  const QString snapshot_path = QDir(directory).filePath("stations.snapshot");
+  QFile::remove(path);
+  QFile::remove(snapshot_path);
+  QDir(snapshot_path).removeRecursively();
+
+  // A directory in place of the snapshot prevents it from being written, so
+  // that queries use SQL.
+  QVERIFY(QDir().mkpath(QDir(snapshot_path).filePath("blocked")));
+
+  // Create the stations.
+  {
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "setup");
+    db.setDatabaseName(path);
+    QVERIFY(db.open());
+    QSqlQuery query(db);
+    QVERIFY(query.exec(
+      "CREATE TABLE Stations("
+      "id INTEGER PRIMARY KEY AUTOINCREMENT, latitude REAL, longitude REAL,"
+      " fuel_price REAL, price_date TEXT, address TEXT,"
+      " UNIQUE(latitude, longitude));"
+    ));
+    QVERIFY(query.exec(
+      "CREATE TABLE Distances("
+      "from_id INTEGER, to_id INTEGER, distance REAL,"
+      " UNIQUE(from_id, to_id),"
+      " FOREIGN KEY(from_id) REFERENCES Stations(id),"
+      " FOREIGN KEY(to_id) REFERENCES Stations(id));"
+    ));
+    QVERIFY(query.exec(QString(
+      "WITH RECURSIVE n(k) AS (SELECT 1 UNION ALL SELECT k + 1 FROM n WHERE k < %1)"
+      " INSERT INTO Stations (id, latitude, longitude, fuel_price, price_date, address)"
+      " SELECT k, 40.0 + k / 1000.0, 9.0 - k / 1000.0, 1.0 + k / 10000.0, '2024-01-01', 'Station ' || k FROM n;"
+    ).arg(STATION_COUNT)));
+    db.close();
+  }
+  QSqlDatabase::removeDatabase("setup");
+
+  QCOMPARE(DatabaseManager::loadDatabase(), QString());
+}
+
+
+void TestStationsFromIds::manyIds()
+{
+  QList<int> ids;
+  for(int id=STATION_COUNT; id>0; id--) {
+    ids.append(id);
+  }
+
+  DatabaseManager database;
+  DatabaseManager::StationData stations;
+  QVERIFY(database.stationsFromIds(ids, DatabaseManager::ALL_COLUMNS, stations));
+  QCOMPARE(stations.ids, ids);
+  QVERIFY(matches(ids, stations));
+}
+
+
+void TestStationsFromIds::duplicateIds()
+{
+  // Enough distinct IDs for several chunks, then the same ones again.
+  QList<int> ids;
+  for(int id=1; id<=2*DatabaseManager::IDS_PER_QUERY; id+=2) {
+    ids.append(id);
+  }
+  ids += ids;
+  ids.append(7);
+  ids.prepend(STATION_COUNT);
+  ids.append(STATION_COUNT);
+
+  DatabaseManager database;
+  DatabaseManager::StationData stations;
+  QVERIFY(database.stationsFromIds(ids, DatabaseManager::ALL_COLUMNS, stations));
+  QCOMPARE(stations.ids, ids);
+  QVERIFY(matches(ids, stations));
+}
+
+
+void TestStationsFromIds::selectedColumns()
+{
+  const QList<int> ids{3, 1, 2};
+  DatabaseManager database;
+  DatabaseManager::StationData stations;
+  QVERIFY(database.stationsFromIds(ids, DatabaseManager::PRICE | DatabaseManager::ADDRESS, stations));
+  QVERIFY(stations.ids.isEmpty());
+  QVERIFY(stations.latitudes.isEmpty());
+  QVERIFY(stations.longitudes.isEmpty());
+  QVERIFY(stations.dates.isEmpty());
+  QCOMPARE(stations.prices, (QList<double>{1.0003, 1.0001, 1.0002}));
+  QCOMPARE(stations.addresses, (QStringList{"Station 3", "Station 1", "Station 2"}));
+}
+
+
+void TestStationsFromIds::missingId()
+{
+  // The missing ID is in the last chunk.
+  QList<int> ids;
+  for(int id=1; id<=2*DatabaseManager::IDS_PER_QUERY; id++) {
+    ids.append(id);
+  }
+  ids.append(STATION_COUNT + 1);
+
+  DatabaseManager database;
+  DatabaseManager::StationData stations;
+  QVERIFY(!database.stationsFromIds(ids, DatabaseManager::ALL_COLUMNS, stations));
+  QVERIFY(stations.ids.isEmpty());
+  QVERIFY(stations.prices.isEmpty());
+  QVERIFY(stations.latitudes.isEmpty());
+  QVERIFY(stations.longitudes.isEmpty());
+  QVERIFY(stations.dates.isEmpty());
+  QVERIFY(stations.addresses.isEmpty());
+}
+
+
+QTEST_GUILESS_MAIN(TestStationsFromIds)
+#include "test_stations_from_ids.moc"